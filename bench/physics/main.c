@@ -0,0 +1,535 @@
+// headless physics benchmark, no window or gl context is created.
+//
+// usage:
+//   make bench && ./physics-bench.out [-s scene] [-n bodies] [-t ticks]
+//                                     [-j threads] [-b broad phase] [-d]
+//                                     [-i iterations]
+//
+// every scene runs at 1k, 10k and 100k bodies unless -n picks a single size
+// (up to 1M), and prints one tab separated row per run so the numbers can be
+// diffed or gated on. save and restore are the cost of one snapshot round
+// trip on the final state of the run, which is also queried right after
+// restoring it to check that the queries do not see bodies it lacks. -b all
+// runs every broad phase in turn for comparing them, brute force only up to
+// BRUTE_MAX_BODIES bodies since it hands every pair to the narrow phase, so
+// its pairs/tick is what the others cull down from.
+// scenes with solid bodies also count the pairs that passed through each
+// other by the end of the run, which should stay 0 at any -i.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine/c-lib/math.h"
+#include "engine/c-lib/time.h"
+#include "engine/physics/physics.h"
+
+#define DEFAULT_TICKS 60
+#define WARMUP_TICKS 10
+#define TICK_DELTA (1.0f / 60.0f)
+#define SNAPSHOT_ROUNDS 20
+#define BRUTE_MAX_BODIES 2000
+
+typedef enum {
+  COLLISION_LAYER_BODY = 1,
+  COLLISION_LAYER_BARREL = 1 << 1,
+  COLLISION_LAYER_TERRAIN = 1 << 2,
+} collision_layer_t;
+
+typedef struct {
+  const char* name;
+  u32 (*build)(u32 body_count); // returns the static body count
+  u32 (*count_tunnels)(void);   // NULL when the scene has no solid bodies
+} scene_t;
+
+static const char* broad_phase_names[] = {
+    [BROAD_PHASE_GRID] = "grid",
+    [BROAD_PHASE_SAP] = "sap",
+    [BROAD_PHASE_BRUTE] = "brute",
+};
+#define BROAD_PHASE_COUNT \
+  (sizeof(broad_phase_names) / sizeof(broad_phase_names[0]))
+
+// -------- allocation counting --------
+// on linux the bench links with -Wl,--wrap so every malloc in the engine
+// comes through here, including the ones made by the worker threads
+static u64 alloc_count;
+
+#ifdef BENCH_COUNT_ALLOCS
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+#endif
+
+// -------- deterministic random numbers --------
+// rand() differs between c libraries, the scenes have to be the same
+// everywhere for the numbers to be comparable
+static u32 rng_state;
+
+static u32 rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static f32 rng_range(f32 min, f32 max) {
+  return min + (max - min) * (rng_next() % 10000) / 10000.0f;
+}
+
+// -------- collision callbacks --------
+static u64 hit_count;
+
+static void count_hit(body_t* self, body_t* other, hit_t hit) {
+  (void)self;
+  (void)other;
+  (void)hit;
+  ++hit_count;
+}
+
+static void bounce_off_walls(body_t* self, static_body_t* other, hit_t hit) {
+  (void)other;
+  if (hit.normal[0] > 0) self->velocity[0] = fabsf(self->velocity[0]) + 60;
+  if (hit.normal[0] < 0) self->velocity[0] = -fabsf(self->velocity[0]) - 60;
+}
+
+// -------- scenes --------
+// the scenes size the world to their body count so density stays the same at
+// every size
+static u32 create_box(f32 width, f32 height) {
+  f32 half_w = width * 0.5f;
+  f32 half_h = height * 0.5f;
+  physics_set_world_bounds((vec2){0, 0}, (vec2){width, height});
+  physics_static_body_create((vec2){half_w, 4}, (vec2){width, 8},
+                             COLLISION_LAYER_TERRAIN);
+  physics_static_body_create((vec2){half_w, height - 4}, (vec2){width, 8},
+                             COLLISION_LAYER_TERRAIN);
+  physics_static_body_create((vec2){4, half_h}, (vec2){8, height},
+                             COLLISION_LAYER_TERRAIN);
+  physics_static_body_create((vec2){width - 4, half_h}, (vec2){8, height},
+                             COLLISION_LAYER_TERRAIN);
+  return 4;
+}
+
+// bodies of mixed sizes dropped from random heights, most of them still in
+// the air during the timed ticks
+static u32 build_crowd(u32 body_count) {
+  f32 side = 32 * sqrtf((f32)body_count);
+  u32 static_count = create_box(side, side);
+  for (u32 i = 0; i < body_count; ++i) {
+    vec2 position = {rng_range(16, side - 16), rng_range(16, side - 16)};
+    vec2 size = {rng_range(6, 12), rng_range(6, 12)};
+    vec2 velocity = {rng_range(-100, 100), rng_range(-50, 50)};
+    physics_body_create(position, size, velocity, NULL, COLLISION_LAYER_BODY,
+                        COLLISION_LAYER_BODY | COLLISION_LAYER_TERRAIN,
+                        false, count_hit, bounce_off_walls);
+  }
+  return static_count;
+}
+
+// columns of touching boxes resting on the floor, the worst case for pair
+// counts since every body overlaps its neighbours' bounds
+#define STACK_HEIGHT 50
+
+static u32 build_stacks(u32 body_count) {
+  u32 column_count = (body_count + STACK_HEIGHT - 1) / STACK_HEIGHT;
+  f32 width = 16 + column_count * 10;
+  u32 static_count = create_box(width, 16 + STACK_HEIGHT * 8 + 64);
+  for (u32 i = 0; i < body_count; ++i) {
+    u32 column = i / STACK_HEIGHT;
+    u32 row = i % STACK_HEIGHT;
+    vec2 position = {13 + column * 10.0f, 12 + row * 8.0f};
+    physics_body_create(position, (vec2){8, 8}, (vec2){0, 0}, NULL,
+                        COLLISION_LAYER_BODY,
+                        COLLISION_LAYER_BODY | COLLISION_LAYER_TERRAIN,
+                        false, count_hit, NULL);
+  }
+  return static_count;
+}
+
+// the same columns with solid bodies, which stop at each other instead of
+// resting on the overlap so every contact takes a second sweep
+static u32 build_solid_stacks(u32 body_count) {
+  u32 static_count = build_stacks(body_count);
+  for (size_t i = 0; i < physics_body_count(); ++i) {
+    physics_body_at(i)->is_solid = true;
+  }
+  return static_count;
+}
+
+// a body ending up below the one stacked on it fell through
+static u32 count_stack_tunnels(void) {
+  u32 count = 0;
+  for (size_t i = 1; i < physics_body_count(); ++i) {
+    if (i % STACK_HEIGHT != 0 && physics_body_at(i)->aabb.position[1] <
+                                     physics_body_at(i - 1)->aabb.position[1]) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// pairs of solid bodies fired at each other along lanes without gravity, from
+// random gaps so they meet all through the run. they close more than both
+// their widths every tick, so they have to stop at the time of impact rather
+// than step past each other.
+#define BULLET_LANE_LENGTH 1024
+
+static u32 build_bullets(u32 body_count) {
+  u32 lane_count = (body_count + 1) / 2;
+  u32 columns = max((u32)sqrtf((f32)lane_count / 64), 1u);
+  u32 rows = (lane_count + columns - 1) / columns;
+  u32 static_count =
+      create_box(16 + columns * BULLET_LANE_LENGTH, 16 + rows * 16.0f);
+  f32 x0 = 0, gap = 0;
+  for (u32 i = 0; i < body_count; ++i) {
+    u32 lane = i / 2;
+    bool is_left = i % 2 == 0;
+    if (is_left) {
+      x0 = 8 + (lane % columns) * BULLET_LANE_LENGTH;
+      gap = rng_range(32, BULLET_LANE_LENGTH - 16);
+    }
+    vec2 position = {is_left ? x0 + 8 : x0 + 8 + gap,
+                     16 + (lane / columns) * 16.0f};
+    f32 speed = rng_range(600, 900);
+    vec2 velocity = {is_left ? speed : -speed, 0};
+    handle_t body = physics_body_create(
+        position, (vec2){8, 8}, velocity, (vec2){0, 0}, COLLISION_LAYER_BODY,
+        COLLISION_LAYER_BODY | COLLISION_LAYER_TERRAIN, false, count_hit,
+        NULL);
+    physics_body_get(body)->is_solid = true;
+  }
+  return static_count;
+}
+
+// the left body of a lane ending up right of its partner went through it
+static u32 count_bullet_tunnels(void) {
+  u32 count = 0;
+  for (size_t i = 1; i < physics_body_count(); i += 2) {
+    if (physics_body_at(i)->aabb.position[0] <
+        physics_body_at(i - 1)->aabb.position[0]) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// donkey kong girders, each 16x8 step one unit higher than the last and
+// alternating direction per floor, with barrels rolling down them
+#define STAIRCASE_STEPS 13
+#define STAIRCASE_BARRELS 8
+#define STAIRCASE_FLOOR_HEIGHT 33
+
+static u32 build_staircases(u32 body_count) {
+  u32 floor_count = (body_count + STAIRCASE_BARRELS - 1) / STAIRCASE_BARRELS;
+  u32 columns = max((u32)sqrtf((f32)floor_count / 4), 1u);
+  u32 rows = (floor_count + columns - 1) / columns;
+  f32 floor_width = STAIRCASE_STEPS * 16 + 32;
+  u32 static_count = create_box(columns * floor_width + 16,
+                                rows * STAIRCASE_FLOOR_HEIGHT + 48);
+
+  u32 barrel = 0;
+  for (u32 f = 0; f < floor_count; ++f) {
+    f32 x0 = 16 + (f % columns) * floor_width;
+    f32 y0 = 16 + (f / columns) * STAIRCASE_FLOOR_HEIGHT;
+    f32 dir = (f / columns) % 2 == 0 ? 1 : -1;
+    for (u32 s = 0; s < STAIRCASE_STEPS; ++s) {
+      f32 x = dir > 0 ? x0 + 8 + s * 16 : x0 + floor_width - 24 - s * 16;
+      physics_static_body_create((vec2){x, y0 + s}, (vec2){16, 8},
+                                 COLLISION_LAYER_TERRAIN);
+      ++static_count;
+    }
+    for (u32 b = 0; b < STAIRCASE_BARRELS && barrel < body_count; ++b) {
+      vec2 position = {x0 + 16 + b * 24, y0 + 20};
+      physics_body_create(position, (vec2){10, 10}, (vec2){-dir * 60, 0},
+                          NULL, COLLISION_LAYER_BARREL,
+                          COLLISION_LAYER_BARREL | COLLISION_LAYER_TERRAIN,
+                          false, count_hit, bounce_off_walls);
+      ++barrel;
+    }
+  }
+  return static_count;
+}
+
+// a tilemap with a quarter of its 16x16 tiles solid, one tile per body
+static u32 build_tiles(u32 body_count) {
+  u32 side_tiles = max((u32)sqrtf((f32)body_count * 4), 4u);
+  f32 side = side_tiles * 16.0f;
+  u32 static_count = create_box(side, side);
+  for (u32 y = 1; y < side_tiles - 1; ++y) {
+    for (u32 x = 1; x < side_tiles - 1; ++x) {
+      if (rng_next() % 4 == 0) {
+        physics_static_body_create((vec2){x * 16 + 8.0f, y * 16 + 8.0f},
+                                   (vec2){16, 16}, COLLISION_LAYER_TERRAIN);
+        ++static_count;
+      }
+    }
+  }
+  for (u32 i = 0; i < body_count; ++i) {
+    vec2 position = {rng_range(16, side - 16), rng_range(16, side - 16)};
+    vec2 velocity = {rng_range(-120, 120), rng_range(-60, 60)};
+    physics_body_create(position, (vec2){6, 6}, velocity, NULL,
+                        COLLISION_LAYER_BODY,
+                        COLLISION_LAYER_BODY | COLLISION_LAYER_TERRAIN,
+                        false, count_hit, bounce_off_walls);
+  }
+  return static_count;
+}
+
+// the same tiles in a tilemap, a byte each instead of a static body
+static u32 build_tilemap(u32 body_count) {
+  u32 side_tiles = max((u32)sqrtf((f32)body_count * 4), 4u);
+  f32 side = side_tiles * 16.0f;
+  u32 static_count = create_box(side, side);
+  size_t tilemap = physics_tilemap_create((vec2){0, 0}, (vec2){16, 16},
+                                          side_tiles, side_tiles);
+  physics_tilemap_set_layer(tilemap, 1, COLLISION_LAYER_TERRAIN);
+  for (u32 y = 1; y < side_tiles - 1; ++y) {
+    for (u32 x = 1; x < side_tiles - 1; ++x) {
+      if (rng_next() % 4 == 0) {
+        physics_tile_set(physics_tilemap_tile(tilemap, x, y), 1);
+      }
+    }
+  }
+  for (u32 i = 0; i < body_count; ++i) {
+    vec2 position = {rng_range(16, side - 16), rng_range(16, side - 16)};
+    vec2 velocity = {rng_range(-120, 120), rng_range(-60, 60)};
+    physics_body_create(position, (vec2){6, 6}, velocity, NULL,
+                        COLLISION_LAYER_BODY,
+                        COLLISION_LAYER_BODY | COLLISION_LAYER_TERRAIN,
+                        false, count_hit, bounce_off_walls);
+  }
+  return static_count;
+}
+
+static const scene_t scenes[] = {
+    {"crowd", build_crowd, NULL},
+    {"stacks", build_stacks, NULL},
+    {"solid", build_solid_stacks, count_stack_tunnels},
+    {"bullets", build_bullets, count_bullet_tunnels},
+    {"staircases", build_staircases, NULL},
+    {"tiles", build_tiles, NULL},
+    {"tilemap", build_tilemap, NULL},
+};
+
+// -------- driver --------
+// restores a snapshot with one body fewer than the world and queries
+// everything straight away, before an update could rebuild the broad phase.
+// the results may only name bodies the snapshot has.
+static bool check_restored_queries(void) {
+  u32 snapshot = physics_snapshot_save();
+  physics_body_create(physics_body_at(0)->aabb.position, (vec2){8, 8},
+                      (vec2){0, 0}, NULL, COLLISION_LAYER_BODY,
+                      COLLISION_LAYER_BODY, false, NULL, NULL);
+  physics_update(TICK_DELTA);
+  physics_snapshot_restore(snapshot);
+
+  size_t capacity = physics_body_count() + physics_static_body_count();
+  query_result_t* results = malloc(capacity * sizeof(query_result_t));
+  aabb_t everything = {.half_size = {1e9f, 1e9f}};
+  size_t count = physics_overlap_aabb(everything, 0xFF, results, capacity);
+  bool is_valid = count <= capacity;
+  for (size_t i = 0; i < count && is_valid; ++i) {
+    is_valid = results[i].is_static || results[i].id < physics_body_count();
+  }
+  free(results);
+  return is_valid;
+}
+
+static void run_scene(const scene_t* scene, u32 body_count, u32 ticks,
+                      u32 threads, u32 iterations,
+                      broad_phase_t broad_phase, bool is_deterministic) {
+  rng_state = 0x9e3779b9;
+  hit_count = 0;
+
+  physics_init(broad_phase);
+  physics_set_thread_count(threads);
+  physics_set_deterministic(is_deterministic ? TICK_DELTA : 0);
+  if (iterations > 0) {
+    *physics_get_iterations() = iterations;
+  }
+  u32 static_count = scene->build(body_count);
+
+  // the first ticks build the broad phase and grow the scratch lists
+  for (u32 i = 0; i < WARMUP_TICKS; ++i) {
+    physics_update(TICK_DELTA);
+  }
+
+  u64 pairs = 0;
+  u64 clamps = 0;
+  u64 hits_before = hit_count;
+  u64 allocs_before = alloc_count;
+  u64 start = time_ns();
+  for (u32 i = 0; i < ticks; ++i) {
+    physics_update(TICK_DELTA);
+    pairs += physics_get_stats().pairs_tested;
+    clamps += physics_get_stats().clamp_count;
+  }
+  u64 elapsed = time_ns() - start;
+  u64 allocs = alloc_count - allocs_before;
+
+  char tunnels[16] = "-";
+  if (scene->count_tunnels != NULL) {
+    snprintf(tunnels, sizeof(tunnels), "%u", scene->count_tunnels());
+  }
+
+  // a rollback round trip on the final state, after the allocation count
+  // since the ring is set up here
+  physics_snapshot_init(2);
+  u32 snapshot = physics_snapshot_save();
+  u64 save_ns = 0;
+  u64 restore_ns = 0;
+  for (u32 i = 0; i < SNAPSHOT_ROUNDS; ++i) {
+    start = time_ns();
+    snapshot = physics_snapshot_save();
+    save_ns += time_ns() - start;
+    start = time_ns();
+    physics_snapshot_restore(snapshot);
+    restore_ns += time_ns() - start;
+  }
+
+  f64 body_ticks = (f64)body_count * ticks;
+  printf("%-10s\t%-5s\t%7u\t%7u\t%5u\t%7u\t%5u\t%10.2f\t%12.1f\t%10.1f\t"
+         "%11.1f\t%11.2f\t%8u\t%7s\t%7.1f\t%10.1f\t%016llx\n",
+         scene->name, broad_phase_names[broad_phase], body_count,
+         static_count, ticks, threads, *physics_get_iterations(),
+         elapsed / body_ticks, (f64)pairs / ticks,
+         (f64)(hit_count - hits_before) / ticks, (f64)clamps / ticks,
+         (f64)allocs / ticks, physics_get_stats().sleeping_count, tunnels,
+         save_ns / 1000.0 / SNAPSHOT_ROUNDS,
+         restore_ns / 1000.0 / SNAPSHOT_ROUNDS,
+         (unsigned long long)physics_get_state_hash());
+  fflush(stdout);
+
+  if (!check_restored_queries()) {
+    fprintf(stderr, "%s: queries after a restore found removed bodies\n",
+            scene->name);
+    exit(1);
+  }
+  physics_destroy();
+}
+
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [-s scene] [-n bodies] [-t ticks] [-j threads] "
+          "[-b broad phase] [-d] [-i iterations]\n"
+          "-b picks grid (the default), sap, brute or all of them\n"
+          "-d runs in deterministic mode, the hashes then match for any "
+          "thread count\n"
+          "-i sets the physics iterations per tick, the engine default "
+          "otherwise\n"
+          "scenes:",
+          program);
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+    fprintf(stderr, " %s", scenes[i].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+  const char* scene_name = NULL;
+  u32 body_count = 0;
+  u32 ticks = DEFAULT_TICKS;
+  u32 threads = 1;
+  u32 iterations = 0;
+  bool is_deterministic = false;
+  bool is_all_broad_phases = false;
+  broad_phase_t broad_phase = BROAD_PHASE_GRID;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:t:j:b:di:h")) != -1) {
+    switch (opt) {
+      case 's':
+        scene_name = optarg;
+        break;
+      case 'n':
+        body_count = (u32)strtoul(optarg, NULL, 10);
+        break;
+      case 't':
+        ticks = max((u32)strtoul(optarg, NULL, 10), 1u);
+        break;
+      case 'j':
+        threads = (u32)strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        is_all_broad_phases = strcmp(optarg, "all") == 0;
+        broad_phase = BROAD_PHASE_COUNT;
+        for (u32 b = 0; b < BROAD_PHASE_COUNT; ++b) {
+          if (strcmp(optarg, broad_phase_names[b]) == 0) {
+            broad_phase = b;
+          }
+        }
+        if (broad_phase == BROAD_PHASE_COUNT && !is_all_broad_phases) {
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'd':
+        is_deterministic = true;
+        break;
+      case 'i':
+        iterations = max((u32)strtoul(optarg, NULL, 10), 1u);
+        break;
+      default:
+        print_usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  u32 sizes[] = {1000, 10000, 100000};
+  u32 size_count = sizeof(sizes) / sizeof(sizes[0]);
+  if (body_count > 0) {
+    sizes[0] = body_count;
+    size_count = 1;
+  }
+
+  printf("scene     \tbroad\t bodies\tstatics\tticks\tthreads\titers\t"
+         "ns/body/tick\t  pairs/tick\t hits/tick\tclamps/tick\tallocs/tick\t"
+         "sleeping\ttunnels\tsave us\trestore us\tstate hash\n");
+  bool found = false;
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+    if (scene_name != NULL && strcmp(scene_name, scenes[i].name) != 0) {
+      continue;
+    }
+    found = true;
+    for (u32 s = 0; s < size_count; ++s) {
+      for (u32 b = 0; b < BROAD_PHASE_COUNT; ++b) {
+        bool is_picked = is_all_broad_phases ? b != BROAD_PHASE_BRUTE ||
+                                                   sizes[s] <= BRUTE_MAX_BODIES
+                                             : b == broad_phase;
+        if (is_picked) {
+          run_scene(&scenes[i], sizes[s], ticks, threads, iterations, b,
+                    is_deterministic);
+        }
+      }
+    }
+  }
+
+  if (!found) {
+    print_usage(argv[0]);
+    return 1;
+  }
+#ifndef BENCH_COUNT_ALLOCS
+  fprintf(stderr, "allocations are only counted on linux builds\n");
+#endif
+  return 0;
+}
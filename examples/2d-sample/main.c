@@ -6,6 +6,7 @@
 #include "engine/entity/entity.h"
 #include "engine/font/font.h"
 #include "engine/physics/physics.h"
+#include "engine/profile/profile.h"
 #include "engine/renderer/render.h"
 #include "engine/renderer/render_init.h"
 #include "engine/state.h"
@@ -16,7 +17,6 @@
 
 // -------- function prototypes --------
 void player_on_hit(body_t* self, body_t* other, hit_t hit);
-void player_on_hit_static(body_t* self, static_body_t* other, hit_t hit);
 void enemy_on_hit_static(body_t* self, static_body_t* other, hit_t hit);
 void kinematic_on_hit_static(body_t* self, static_body_t* other, hit_t hit);
 void kinematic_on_hit(body_t* self, body_t* other, hit_t hit);
@@ -42,14 +42,14 @@ static u8 kinematic_mask =
 
 // -------- physics and animation ids  --------
 static size_t sb_a_id, sb_b_id, sb_c_id, sb_d_id, sb_e_id; // static bodies
-static size_t kin_id;                                      // kinematic body
-static size_t e_player_id, e_a_id, e_b_id;                 // entities
-static size_t anim_player_idle_id, anim_player_walk_id;    // player animations
+static handle_t kin_id;                                    // kinematic body
+static handle_t e_player_id, e_a_id, e_b_id;               // entities
+static handle_t player_body_id;                            // player's body
+static handle_t anim_player_idle_id, anim_player_walk_id;  // player animations
 
 // -------- player game data --------
 static f32 player_size = 36;
 static vec4 player_aabb_color = {0, 1, 1, 1};
-static bool player_is_grounded = false;
 
 // -------- debug data -------------
 static bool is_paused = false;
@@ -64,11 +64,6 @@ void player_on_hit(body_t* self, body_t* other, hit_t hit) {
     player_aabb_color[2] = 0;
   }
 }
-void player_on_hit_static(body_t* self, static_body_t* other, hit_t hit) {
-  (void)self;
-  (void)other;
-  if (hit.normal[1] > 0) player_is_grounded = true;
-}
 void enemy_on_hit_static(body_t* self, static_body_t* other, hit_t hit) {
   (void)other;
   if (hit.normal[0] > 0) self->velocity[0] = 400;
@@ -105,6 +100,9 @@ void setup_bodies_entities_anims(sprite_sheet_t* bg_sheet) {
   vec2 enemy_size = {player_size * 0.5f, player_size * 0.5f};
   vec2 enemy_vel = {400, 0};
 
+  // bodies are kept on screen
+  physics_set_world_bounds((vec2){0, 0}, (vec2){render_width, render_height});
+
   // static body boundaries
   sb_a_id = CREATE_BLOCK(half_w, render_height - 12, render_width - 1, 12);
   sb_b_id = CREATE_BLOCK(render_width - 12, half_h, 12, render_height - 1);
@@ -124,15 +122,16 @@ void setup_bodies_entities_anims(sprite_sheet_t* bg_sheet) {
   e_player_id = entity_create(
       "player", (vec2){half_w - player_size * 3.0f, half_h},
       (vec2){player_size, player_size}, zero_vel, NULL, COLLISION_LAYER_PLAYER,
-      player_mask, false, (size_t)-1, player_on_hit, player_on_hit_static);
+      player_mask, false, HANDLE_NONE, player_on_hit, NULL);
+  player_body_id = entity_get(e_player_id)->body_id;
 
   e_a_id = entity_create("enemy one", (vec2){half_w - 50, half_h}, enemy_size,
                          enemy_vel, NULL, COLLISION_LAYER_ENEMY, enemy_mask,
-                         false, (size_t)-1, NULL, enemy_on_hit_static);
+                         false, HANDLE_NONE, NULL, enemy_on_hit_static);
 
   e_b_id = entity_create("enemy two", (vec2){half_w + 50, half_h}, enemy_size,
                          enemy_vel, NULL, COLLISION_LAYER_ENEMY, enemy_mask,
-                         false, (size_t)-1, NULL, enemy_on_hit_static);
+                         false, HANDLE_NONE, NULL, enemy_on_hit_static);
 
   // player animations
   f32* anim_times = (f32[]){0.2f, 0.2f};
@@ -155,9 +154,10 @@ void input_handle(body_t* body_player) {
   body_player->velocity[0] = 0;
   if (state.input.states[INPUT_KEY_RIGHT] > 0) body_player->velocity[0] += 160;
   if (state.input.states[INPUT_KEY_LEFT] > 0) body_player->velocity[0] -= 160;
-  if (state.input.states[INPUT_KEY_UP] > 0 && player_is_grounded) {
+  bool is_grounded = physics_body_is_touching(
+      player_body_id, COLLISION_LAYER_TERRAIN, CONTACT_UP);
+  if (state.input.states[INPUT_KEY_UP] > 0 && is_grounded) {
     body_player->velocity[1] = 250;
-    player_is_grounded = false;
   }
 }
 
@@ -165,9 +165,11 @@ void input_handle(body_t* body_player) {
 int main(void) {
   // engine system initialization
   time_init(60);
+  time_set_tick_rate(60, 4);
+  profile_init();
   config_init();
   render_init(1280, 720, 3.0f, (vec4){0, 0, 0, 1});
-  physics_init();
+  physics_init(BROAD_PHASE_GRID);
   entity_init();
   animation_init();
   audio_init();
@@ -203,9 +205,12 @@ int main(void) {
   (void)height;
 
   while (!glfwWindowShouldClose(state.window)) {
-    // get data from the ids (using ids bc the ptrs could be invalidated)
+    // handles stay valid across frames, pointers only until the next create
     entity_t* player = entity_get(e_player_id);
-    body_t* body_player = physics_body_get(player->body_id);
+    body_t* body_player = physics_body_get(player_body_id);
+
+    // everything from here to the frame wait shows up in the editor profiler
+    profile_frame_begin();
 
     // always update the time and input handler
     time_update();
@@ -232,7 +237,11 @@ int main(void) {
     if (!is_paused || advance_frame) {
       // if we aren't paused, we can update the physics and animations
       input_handle(body_player);
-      physics_update(state.time.delta);
+      // stepping while paused always advances a single tick
+      u32 tick_count = is_paused ? 1 : state.time.tick_count;
+      for (u32 i = 0; i < tick_count; ++i) {
+        physics_update(state.time.tick_delta);
+      }
       animation_update(state.time.delta);
 
       player->animation_id = body_player->velocity[0] != 0.0f
@@ -250,7 +259,7 @@ int main(void) {
     // render all of the aabbs if we are in debug mode
     if (editor_is_debug()) {
       for (size_t i = 0; i < physics_body_count(); ++i) {
-        body_t* body = physics_body_get(i);
+        body_t* body = physics_body_at(i);
         render_aabb((f32*)&body->aabb, WHITE);
       }
       for (size_t i = 0; i < physics_static_body_count(); ++i) {
@@ -260,10 +269,12 @@ int main(void) {
       render_aabb((f32*)&body_player->aabb, player_aabb_color); // player body
     }
 
-    // render the currently active entity animations from sprite sheet
+    // render the currently active entity animations from sprite sheet, in
+    // between the last two physics ticks so movement stays smooth
+    f32 alpha = is_paused ? 1.0f : state.time.alpha;
     for (size_t i = 0; i < entity_count(); ++i) {
-      entity_t* entity = entity_get(i);
-      if (!entity->is_active || entity->animation_id == (size_t)-1) {
+      entity_t* entity = entity_at(i);
+      if (!entity->is_active || entity->animation_id == HANDLE_NONE) {
         // it does not have an animation id right now, just skip
         continue;
       }
@@ -274,7 +285,9 @@ int main(void) {
       } else if (body->velocity[0] > 0) {
         anim->is_flipped = false;
       }
-      animation_render_current_frame(anim, body->aabb.position,
+      vec2 position;
+      physics_body_interpolate(position, body, alpha);
+      animation_render_current_frame(anim, position,
                                      (vec2){player_size, player_size}, WHITE);
     }
 
@@ -296,6 +309,7 @@ int main(void) {
     player_aabb_color[2] = 1;
 
     time_update_late();
+    profile_frame_end();
   }
 
   // engine system de-initialization
@@ -306,4 +320,5 @@ int main(void) {
   entity_destroy();
   physics_destroy();
   render_destroy();
+  profile_destroy();
 }
@@ -4,6 +4,7 @@
 #include "engine/editor/editor.h"
 #include "engine/entity/entity.h"
 #include "engine/physics/physics.h"
+#include "engine/profile/profile.h"
 #include "engine/renderer/render.h"
 #include "engine/renderer/render_init.h"
 #include "engine/state.h"
@@ -20,14 +21,13 @@
     vec2_add(_pos, _pos, _dxv); \
   } \
 }
+// ladders never move but climbing runs from their own on_hit, keep them awake
 #define CREATE_LADDER(_x, _y, _w, _h) \
-  physics_body_create((vec2){_x, _y}, (vec2){_w, _h}, (vec2){0, 0}, 0, COLLISION_LAYER_LADDER, ladder_mask, true, ladder_on_hit, ladder_on_hit_static);
+  physics_body_get(physics_body_create((vec2){_x, _y}, (vec2){_w, _h}, (vec2){0, 0}, 0, COLLISION_LAYER_LADDER, ladder_mask, true, ladder_on_hit, ladder_on_hit_static))->is_always_awake = true;
 
 // -------- function prototypes --------
 void ladder_on_hit(body_t* self, body_t* other, hit_t hit);
 void ladder_on_hit_static(body_t* self, static_body_t* other, hit_t hit);
-void mario_on_hit(body_t* self, body_t* other, hit_t hit);
-void mario_on_hit_static(body_t* self, static_body_t* other, hit_t hit);
 void setup_bodies_entities_anims(sprite_sheet_t* bg_sheet,
                                  sprite_sheet_t* sprites);
 void input_handle(body_t* body);
@@ -48,10 +48,10 @@ static u8 ladder_mask = COLLISION_LAYER_MARIO;
 static u8 mario_mask = COLLISION_LAYER_TERRAIN | COLLISION_LAYER_LADDER;
 
 // -------- physics and animation ids  --------
-static size_t mario_eid;
-static size_t anim_level;
-static size_t anim_mario_idle, anim_mario_walk, anim_mario_jump;
-static size_t anim_mario_climb_idle, anim_mario_climb_dyn;
+static handle_t mario_eid, mario_body_id;
+static handle_t anim_level;
+static handle_t anim_mario_idle, anim_mario_walk, anim_mario_jump;
+static handle_t anim_mario_climb_idle, anim_mario_climb_dyn;
 
 // -------- player game data --------
 static const f32 mario_size = 14;
@@ -60,7 +60,6 @@ static bool mario_is_grounded = false;
 static bool mario_is_flipped = true;
 static int mario_move_dir = 0;
 static bool mario_is_on_ladder = false;
-static bool mario_is_overlapping_ladder = false;
 
 // -------- debug data -------------
 static bool is_paused = false;
@@ -73,7 +72,8 @@ void ladder_on_hit(body_t* self, body_t* other, hit_t hit) {
     return;
   }
 
-  if (mario_is_overlapping_ladder && !mario_is_on_ladder && mario_is_grounded) {
+  // mario is overlapping this ladder, it only hits him when they do
+  if (!mario_is_on_ladder && mario_is_grounded) {
     // check to ENTER ladder mode
     if (state.input.states[INPUT_KEY_UP] > 0 ||
         state.input.states[INPUT_KEY_DOWN] > 0) {
@@ -121,21 +121,6 @@ void ladder_on_hit_static(body_t* self, static_body_t* other, hit_t hit) {
   (void)other;
   (void)hit;
 }
-void mario_on_hit(body_t* self, body_t* other, hit_t hit) {
-  (void)self;
-  (void)hit;
-  if (other->collision_layer == COLLISION_LAYER_LADDER) {
-    mario_is_overlapping_ladder = true;
-  }
-}
-void mario_on_hit_static(body_t* self, static_body_t* other, hit_t hit) {
-  (void)self;
-  (void)other;
-  (void)hit;
-  if (hit.normal[1] > 0) {
-    mario_is_grounded = true;
-  }
-}
 
 // -------- data setup initialization --------
 void setup_bodies_entities_anims(sprite_sheet_t* bg_sheet,
@@ -147,6 +132,9 @@ void setup_bodies_entities_anims(sprite_sheet_t* bg_sheet,
   f32 half_w = render_width * 0.5f;
   f32 half_h = render_height * 0.5f;
 
+  // bodies are kept on screen
+  physics_set_world_bounds((vec2){0, 0}, (vec2){render_width, render_height});
+
   // perimeter
   CREATE_BLOCK(half_w, render_height - 2, render_width - 1, 2);
   CREATE_BLOCK(render_width - 2, half_h, 2, render_height - 1);
@@ -155,9 +143,10 @@ void setup_bodies_entities_anims(sprite_sheet_t* bg_sheet,
 
   mario_eid = entity_create("mario", (vec2){80, 20}, (vec2){9, 9}, (vec2){0, 0},
                             NULL, COLLISION_LAYER_MARIO, mario_mask, false,
-                            (size_t)-1, mario_on_hit, mario_on_hit_static);
+                            HANDLE_NONE, NULL, NULL);
+  mario_body_id = entity_get(mario_eid)->body_id;
   *physics_get_terminal_velocity() = -93;
-  physics_body_get(entity_get(mario_eid)->body_id)->acceleration[1] = -5.0f;
+  physics_body_get(mario_body_id)->acceleration[1] = -5.0f;
 
   // staircase and platforms
   vec2 step_size = (vec2){16, 8};
@@ -239,8 +228,10 @@ void input_handle(body_t* body) {
     mario_move_dir = -1;
     body->velocity[0] -= 80;
   }
+  bool is_at_ladder = physics_body_is_touching(
+      mario_body_id, COLLISION_LAYER_LADDER, CONTACT_ANY);
   if (state.input.states[INPUT_KEY_UP] > 0 && mario_is_grounded &&
-      !mario_is_overlapping_ladder) {
+      !is_at_ladder) {
     body->velocity[1] = 90;
     mario_is_grounded = false;
   }
@@ -250,9 +241,11 @@ void input_handle(body_t* body) {
 int main(void) {
   // engine system initialization
   time_init(60);
+  time_set_tick_rate(60, 4);
+  profile_init();
   config_init();
   render_init(800, 800, 3.0f, BLACK);
-  physics_init();
+  physics_init(BROAD_PHASE_GRID);
   entity_init();
   animation_init();
   // audio_init();
@@ -276,8 +269,12 @@ int main(void) {
   (void)height;
 
   while (!glfwWindowShouldClose(state.window)) {
+    // handles stay valid across frames, pointers only until the next create
     entity_t* mario = entity_get(mario_eid);
-    body_t* mario_body = physics_body_get(mario->body_id);
+    body_t* mario_body = physics_body_get(mario_body_id);
+
+    // everything from here to the frame wait shows up in the editor profiler
+    profile_frame_begin();
 
     // always update the time and input handler
     time_update();
@@ -305,15 +302,25 @@ int main(void) {
       // if we aren't paused, we can update the physics and animations
       input_handle(mario_body);
 
-      mario_is_overlapping_ladder = false;
-
-      f32 grav = mario_body->acceleration[1];
-      if (mario_is_grounded) {
-        mario_body->aabb.position[1] += 1.0f;
-        mario_body->acceleration[1] = -10000;
+      // stepping while paused always advances a single tick
+      u32 tick_count = is_paused ? 1 : state.time.tick_count;
+      for (u32 i = 0; i < tick_count; ++i) {
+        f32 grav = mario_body->acceleration[1];
+        if (mario_is_grounded) {
+          mario_body->aabb.position[1] += 1.0f;
+          mario_body->acceleration[1] = -10000;
+        }
+        physics_update(state.time.tick_delta);
+        mario_body->acceleration[1] = grav;
+        // grounded holds until a jump or the ladder clears it, stepping down
+        // the stairs misses the floor for a tick. the ladder hit that started
+        // a climb may come with a floor contact from the same update.
+        if (!mario_is_on_ladder &&
+            physics_body_is_touching(mario_body_id, COLLISION_LAYER_TERRAIN,
+                                     CONTACT_UP)) {
+          mario_is_grounded = true;
+        }
       }
-      physics_update(state.time.delta);
-      mario_body->acceleration[1] = grav;
 
       animation_update(state.time.delta);
 
@@ -339,10 +346,12 @@ int main(void) {
                                    (vec2){width * 0.5f, height * 0.5f}, NULL,
                                    WHITE);
 
-    // render the currently active entity animations from sprite sheet
+    // render the currently active entity animations from sprite sheet, in
+    // between the last two physics ticks so movement stays smooth
+    f32 alpha = is_paused ? 1.0f : state.time.alpha;
     for (size_t i = 0; i < entity_count(); ++i) {
-      entity_t* entity = entity_get(i);
-      if (!entity->is_active || entity->animation_id == (size_t)-1) {
+      entity_t* entity = entity_at(i);
+      if (!entity->is_active || entity->animation_id == HANDLE_NONE) {
         // it does not have an animation id right now, just skip
         continue;
       }
@@ -356,7 +365,8 @@ int main(void) {
       anim->is_flipped = mario_is_flipped;
 
       vec2 offset;
-      vec2_add(offset, body->aabb.position, (vec2){0, 3});
+      physics_body_interpolate(offset, body, alpha);
+      vec2_add(offset, offset, (vec2){0, 3});
       animation_render_current_frame(anim, offset,
                                      (vec2){mario_size, mario_size}, WHITE);
     }
@@ -367,7 +377,7 @@ int main(void) {
     // render all of the aabbs if we are in debug mode
     if (editor_is_debug()) {
       for (size_t i = 0; i < physics_body_count(); ++i) {
-        body_t* body = physics_body_get(i);
+        body_t* body = physics_body_at(i);
         render_aabb((f32*)&body->aabb, WHITE);
       }
       for (size_t i = 0; i < physics_static_body_count(); ++i) {
@@ -383,6 +393,7 @@ int main(void) {
     render_end();    // glfw swap buffer
 
     time_update_late();
+    profile_frame_end();
   }
 
   // engine system de-initialization
@@ -392,4 +403,5 @@ int main(void) {
   entity_destroy();
   physics_destroy();
   render_destroy();
+  profile_destroy();
 }
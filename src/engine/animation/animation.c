@@ -2,23 +2,40 @@
 
 #include "../c-lib/dynlist.h"
 #include "../c-lib/log.h"
+#include "../profile/profile.h"
 
 static DYNLIST(animation_definition_t) animation_definition_list;
 static DYNLIST(animation_t) animation_list;
+static DYNLIST(u32) animation_generations; // current generation of every slot
+static DYNLIST(u32) animation_free_list; // inactive slots, last in first out
 
 void animation_init(void) {
   animation_definition_list = dynlist_create(animation_definition_t);
   animation_list = dynlist_create(animation_t);
+  animation_generations = dynlist_create(u32);
+  animation_free_list = dynlist_create(u32);
   LOG("Animation system initialized");
 }
 
 void animation_destroy(void) {
   dynlist_destroy(animation_definition_list);
   dynlist_destroy(animation_list);
+  dynlist_destroy(animation_generations);
+  dynlist_destroy(animation_free_list);
   LOG("Animation system deinitialized");
 }
 
-void animation_deactivate(size_t idx) { animation_get(idx)->is_active = false; }
+void animation_deactivate(handle_t handle) {
+  // stale handles are ignored so deactivating twice is harmless
+  if (!animation_is_valid(handle)) {
+    return;
+  }
+  u32 idx = handle_index(handle);
+  animation_list[idx].is_active = false;
+  animation_generations[idx] =
+      handle_next_generation(animation_generations[idx]);
+  *dynlist_append(animation_free_list) = idx;
+}
 
 size_t animation_definition_count(void) {
   return dynlist_size(animation_definition_list);
@@ -53,12 +70,23 @@ size_t animation_definition_create(sprite_sheet_t* sprite_sheet, f32* durations,
 
 size_t animation_count(void) { return dynlist_size(animation_list); }
 
-animation_t* animation_get(size_t idx) {
+bool animation_is_valid(handle_t handle) {
+  u32 idx = handle_index(handle);
+  return idx < dynlist_size(animation_generations) &&
+         animation_generations[idx] == handle_generation(handle);
+}
+
+animation_t* animation_get(handle_t handle) {
+  ASSERT(animation_is_valid(handle), "stale or invalid animation handle");
+  return &animation_list[handle_index(handle)];
+}
+
+animation_t* animation_at(size_t idx) {
   ASSERT(idx < dynlist_size(animation_list));
   return &animation_list[idx];
 }
 
-size_t animation_create(size_t animation_definition_id, bool does_loop) {
+handle_t animation_create(size_t animation_definition_id, bool does_loop) {
   animation_definition_t* adef =
       &animation_definition_list[animation_definition_id];
   if (adef == NULL) {
@@ -66,19 +94,16 @@ size_t animation_create(size_t animation_definition_id, bool does_loop) {
                animation_definition_id);
   }
 
-  // find a free slot
-  size_t size = dynlist_size(animation_list);
-  size_t idx = size;
-  for (size_t i = 0; i < size /* TODO use dynlist_each instead */; ++i) {
-    animation_t* animation = &animation_list[i];
-    if (!animation->is_active) {
-      idx = i;
-      break;
-    }
-  }
-
-  if (idx == size) {
+  // dynlist_pop reallocates on every call, shrinking by hand keeps this O(1)
+  size_t idx;
+  size_t free_count = dynlist_size(animation_free_list);
+  if (free_count > 0) {
+    idx = animation_free_list[free_count - 1];
+    dynlist_resize_no_contract(animation_free_list, free_count - 1);
+  } else {
+    idx = dynlist_size(animation_list);
     *dynlist_append(animation_list) = (animation_t){0};
+    *dynlist_append(animation_generations) = 1;
   }
 
   animation_t* animation = &animation_list[idx];
@@ -92,13 +117,31 @@ size_t animation_create(size_t animation_definition_id, bool does_loop) {
       .is_flipped = false,
   };
 
-  return idx;
+  return handle_make(idx, animation_generations[idx]);
+}
+
+void animation_create_n(size_t count, handle_t* handles,
+                        size_t animation_definition_id, bool does_loop) {
+  size_t free_count = dynlist_size(animation_free_list);
+  size_t needed =
+      dynlist_size(animation_list) + (count - min(count, free_count));
+  if (dynlist_capacity(animation_list) < needed) {
+    dynlist_ensure(animation_list, needed);
+  }
+  if (dynlist_capacity(animation_generations) < needed) {
+    dynlist_ensure(animation_generations, needed);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    handles[i] = animation_create(animation_definition_id, does_loop);
+  }
 }
 
 void animation_update(f32 delta_time) {
+  PROFILE_SCOPE("animation");
   size_t size = dynlist_size(animation_list);
   for (size_t i = 0; i < size; ++i) {
-    animation_t* animation = animation_get(i);
+    animation_t* animation = animation_at(i);
     animation_definition_t* adef =
         animation_definition_get(animation->animation_definition_id);
 
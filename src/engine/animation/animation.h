@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../c-lib/handle.h"
 #include "../c-lib/types.h"
 #include "../renderer/render.h"
 
@@ -27,7 +28,7 @@ typedef struct {
 
 void animation_init(void);
 void animation_destroy(void);
-void animation_deactivate(size_t idx);
+void animation_deactivate(handle_t animation);
 
 // instance approach so that each animation can have different frame timing/sync
 size_t animation_definition_count(void);
@@ -35,9 +36,18 @@ animation_definition_t* animation_definition_get(size_t idx);
 size_t animation_definition_create(sprite_sheet_t* sprite_sheet, f32* durations,
                                    u8* rows, u8* columns, u8 frame_count);
 
+// animations are referred to by generational handles like bodies, pointers
+// are only good until the next animation is created
 size_t animation_count(void);
-animation_t* animation_get(size_t idx);
-size_t animation_create(size_t animation_definition_id, bool does_loop);
+bool animation_is_valid(handle_t animation);
+animation_t* animation_get(handle_t animation);
+// slot access for walking every animation (active or not) by index
+animation_t* animation_at(size_t idx);
+handle_t animation_create(size_t animation_definition_id, bool does_loop);
+// creates count animations of the same definition, writing their handles to
+// handles. the animation list grows at most once.
+void animation_create_n(size_t count, handle_t* handles,
+                        size_t animation_definition_id, bool does_loop);
 
 void animation_update(f32 delta_time);
 void animation_render_current_frame(animation_t* animation, vec2 position,
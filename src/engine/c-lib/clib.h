@@ -5,6 +5,7 @@
 #include <stdlib.h>
 
 #include "dynlist.h"
+#include "handle.h"
 #include "log.h"
 #include "macros.h"
 #include "time.h" // included before math.h
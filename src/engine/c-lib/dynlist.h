@@ -268,7 +268,7 @@ static M_UNUSED void _dynlist_remove_impl(void** plist, size_t index,
   ASSERT(h->size != 0);
   ASSERT(index < h->size);
 
-  u8* data = (u8*)h + 1;
+  u8* data = (u8*)*plist;
   memmove(data + (index * h->t_size), data + ((index + 1) * h->t_size),
           (h->size - index - 1) * h->t_size);
 
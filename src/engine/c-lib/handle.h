@@ -0,0 +1,30 @@
+#ifndef _LIB_HANDLE_H
+#define _LIB_HANDLE_H
+
+#include "macros.h"
+#include "types.h"
+
+// generational handle to a slot in a pool: the slot index in the low 32 bits
+// and the slot's generation in the high 32 bits. pools bump the generation
+// when a slot is freed, so handles to the old occupant stop matching. live
+// generations start at 1, a zero handle never refers to anything.
+typedef u64 handle_t;
+
+#define HANDLE_NONE ((handle_t)0)
+
+M_INLINE handle_t handle_make(u32 index, u32 generation) {
+  return ((handle_t)generation << 32) | index;
+}
+
+M_INLINE u32 handle_index(handle_t handle) { return (u32)handle; }
+
+M_INLINE u32 handle_generation(handle_t handle) {
+  return (u32)(handle >> 32);
+}
+
+// the generation a freed slot moves to, skipping the never valid zero
+M_INLINE u32 handle_next_generation(u32 generation) {
+  return generation + 1 != 0 ? generation + 1 : 1;
+}
+
+#endif
@@ -8,8 +8,9 @@
 #include "macros.h"
 #include "time.h"
 
-M_INLINE void _log(const char* file, int line, const char* func,
-                   const char* prefix, const char* fmt, ...) {
+// not M_INLINE, gcc refuses to always_inline a variadic function
+static inline M_UNUSED void _log(const char* file, int line, const char* func,
+                                 const char* prefix, const char* fmt, ...) {
   va_list ap;
   va_start(ap, fmt);
   FILE* fp = !strcmp(prefix, "LOG") ? stdout : stderr;
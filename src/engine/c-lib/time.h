@@ -43,5 +43,19 @@ M_INLINE u64 time_ns(void) {
 
 M_INLINE f64 time_s(void) { return time_ns() / 1000000000.0; }
 
+#elif CLIB_TIME_POSIX
+#include <time.h>
+
+M_INLINE f64 time_s(void);
+M_INLINE u64 time_ns(void);
+
+M_INLINE u64 time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+M_INLINE f64 time_s(void) { return time_ns() / 1000000000.0; }
+
 #endif
 #endif
@@ -1,5 +1,6 @@
 #include "input.h"
 
+#include "../profile/profile.h"
 #include "../state.h"
 
 static void update_key_state(bool is_down, key_state_t* key_state) {
@@ -13,6 +14,7 @@ static void update_key_state(bool is_down, key_state_t* key_state) {
 }
 
 void input_update(void) {
+  PROFILE_SCOPE("input");
   glfwPollEvents();
 
   for (u32 i = 0; i < INPUT_KEY_COUNT; ++i) {
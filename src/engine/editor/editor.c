@@ -5,6 +5,8 @@
 
 #include "../entity/entity.h"
 #include "../physics/physics.h"
+#include "../profile/profile.h"
+#include "../renderer/render.h"
 #include "../state.h"
 
 #define GLFW_INCLUDE_NONE
@@ -43,6 +45,9 @@
 #define LABELED_INPUT_U8(_label, _val) \
     LABEL_LEFT(_label); \
     igInputScalar("##" _label, ImGuiDataType_U8, _val, NULL, NULL, "%u", 0);
+#define LABELED_INPUT_U32(_label, _val) \
+    LABEL_LEFT(_label); \
+    igInputScalar("##" _label, ImGuiDataType_U32, _val, NULL, NULL, "%u", 0);
 #define OPTION_NONE \
   if (igSelectable_Bool("None", selected_static_body_id == -1, 0, ZERO_VEC))
 #define DEFAULT_OPEN ImGuiTreeNodeFlags_DefaultOpen
@@ -50,8 +55,8 @@
 #define ZERO_VEC (ImVec2){0, 0}
 
 static ImGuiIO* ioptr; // main ImGui IO object
-static int selected_entity_id = -1;
-static int selected_body_id = -1;
+static handle_t selected_entity = HANDLE_NONE;
+static handle_t selected_body = HANDLE_NONE;
 static int selected_static_body_id = -1;
 static bool is_debug_mode = false;
 static bool is_visible = false;
@@ -129,29 +134,134 @@ static void imgui_new_frame(void) {
   igNewFrame();
 }
 
+#define PROFILE_ROW_HEIGHT 18.0f
+
+// abgr, a few well apart hues so neighbouring zones are told apart
+static u32 zone_color(u16 zone) {
+  static const u32 colors[] = {0xFF4F81BD, 0xFF50A050, 0xFF3C78D8,
+                               0xFFB05CA0, 0xFF2CA0C0, 0xFF6060D0,
+                               0xFFA08040, 0xFF40B0B0};
+  return colors[zone % (sizeof(colors) / sizeof(colors[0]))];
+}
+
+// the last frame's zones laid out over time, one row per nesting depth
+static void render_profile_timeline(void) {
+  size_t count;
+  const profile_record_t* records = profile_get_frame(&count);
+  if (count == 0) {
+    return;
+  }
+
+  u8 depth_count = 0;
+  for (size_t i = 0; i < count; ++i) {
+    depth_count = records[i].depth + 1 > depth_count ? records[i].depth + 1
+                                                     : depth_count;
+  }
+
+  ImVec2 origin, avail;
+  igGetCursorScreenPos(&origin);
+  igGetContentRegionAvail(&avail);
+  f32 height = depth_count * PROFILE_ROW_HEIGHT;
+  f32 scale = avail.x / (f32)(records[0].end_ns - records[0].begin_ns);
+  ImDrawList* draw_list = igGetWindowDrawList();
+  ImDrawList_PushClipRect(draw_list, origin,
+                          (ImVec2){origin.x + avail.x, origin.y + height},
+                          true);
+
+  for (size_t i = 0; i < count; ++i) {
+    const profile_record_t* record = &records[i];
+    ImVec2 min = {origin.x + record->begin_ns * scale,
+                  origin.y + record->depth * PROFILE_ROW_HEIGHT};
+    ImVec2 max = {origin.x + record->end_ns * scale,
+                  min.y + PROFILE_ROW_HEIGHT - 1};
+    // zones too short to see still get a sliver
+    max.x = max.x > min.x + 1 ? max.x : min.x + 1;
+    ImDrawList_AddRectFilled(draw_list, min, max, zone_color(record->zone), 0,
+                             0);
+
+    profile_zone_stats_t stats = profile_zone_stats(record->zone);
+    ImDrawList_PushClipRect(draw_list, min, max, true);
+    ImDrawList_AddText_Vec2(draw_list, (ImVec2){min.x + 2, min.y + 1},
+                            0xFFFFFFFF, stats.name, NULL);
+    ImDrawList_PopClipRect(draw_list);
+    if (igIsMouseHoveringRect(min, max, true)) {
+      igSetTooltip("%s: %.3f ms", stats.name,
+                   (record->end_ns - record->begin_ns) / 1000000.0);
+    }
+  }
+
+  ImDrawList_PopClipRect(draw_list);
+  igDummy((ImVec2){avail.x, height});
+}
+
 static void render_performance_window(void) {
   if (igCollapsingHeader_TreeNodeFlags("Performance", 0)) {
     igText("FPS: %.1f", ioptr->Framerate);
     igText("Frame Time: %.3f ms", 1000.0f / ioptr->Framerate);
     igText("Delta Time: %.4f s", state.time.delta);
+    igText("Ticks: %u (alpha %.2f)", state.time.tick_count, state.time.alpha);
+    render_stats_t render_stats = render_get_stats();
+    igText("Quads: %u (%u flushes)", render_stats.quad_count,
+           render_stats.sprite_flushes);
+    igText("Lines: %u (%u flushes)", render_stats.line_count,
+           render_stats.line_flushes);
+    igText("Texture Slots: %u", render_get_texture_slot_count());
+    LABELED_CHECKBOX("Sort By Texture", render_get_sort_by_texture());
+
+    // -- profiler --
+    igSeparator();
+    igText("Zones over the last %d frames (ms)", PROFILE_FRAME_COUNT);
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (igBeginTable("Profile Zones", 6, flags, ZERO_VEC, 0)) {
+      igTableSetupColumn("Zone", 0, 0, 0);
+      igTableSetupColumn("Calls", 0, 0, 0);
+      igTableSetupColumn("Last", 0, 0, 0);
+      igTableSetupColumn("Min", 0, 0, 0);
+      igTableSetupColumn("Avg", 0, 0, 0);
+      igTableSetupColumn("Max", 0, 0, 0);
+      igTableHeadersRow();
+      for (size_t i = 0; i < profile_zone_count(); ++i) {
+        profile_zone_stats_t stats = profile_zone_stats(i);
+        igTableNextRow(0, 0);
+        igTableNextColumn();
+        igText("%*s%s", stats.depth * 2, "", stats.name);
+        igTableNextColumn();
+        igText("%u", stats.calls);
+        igTableNextColumn();
+        igText("%.3f", stats.last);
+        igTableNextColumn();
+        igText("%.3f", stats.min);
+        igTableNextColumn();
+        igText("%.3f", stats.avg);
+        igTableNextColumn();
+        igText("%.3f", stats.max);
+      }
+      igEndTable();
+    }
+    render_profile_timeline();
   }
 }
 
 static void render_entity_inspector(void) {
   if (igCollapsingHeader_TreeNodeFlags("Entity Inspector", NO_FLAGS)) {
     // -- entity selection --
-    const char* preview = (selected_entity_id == -1)
+    // the selection is dropped once the entity is deactivated elsewhere
+    if (!entity_is_valid(selected_entity)) {
+      selected_entity = HANDLE_NONE;
+    }
+    const char* preview = (selected_entity == HANDLE_NONE)
                               ? "None"
-                              : entity_get_name(selected_entity_id);
+                              : entity_get_name(selected_entity);
 
     LABELED_COMBO("Selected Entity", preview, 0) {
-      OPTION_NONE { selected_entity_id = -1; }
+      OPTION_NONE { selected_entity = HANDLE_NONE; }
       for (size_t i = 0; i < entity_count(); i++) {
-        entity_t* entity = entity_get(i);
+        entity_t* entity = entity_at(i);
         if (entity->is_active) {
-          const bool is_selected = (selected_entity_id == (int)i);
+          handle_t handle = entity_handle_at(i);
+          const bool is_selected = (selected_entity == handle);
           if (igSelectable_Bool(entity->name, is_selected, 0, ZERO_VEC)) {
-            selected_entity_id = i;
+            selected_entity = handle;
           }
           if (is_selected) {
             igSetItemDefaultFocus();
@@ -164,12 +274,14 @@ static void render_entity_inspector(void) {
     igSeparator();
 
     // -- entity properties --
-    if (selected_entity_id != -1) {
-      entity_t* entity = entity_get(selected_entity_id);
+    if (selected_entity != HANDLE_NONE) {
+      entity_t* entity = entity_get(selected_entity);
       body_t* body = physics_body_get(entity->body_id);
 
-      igText("Entity ID: %d", selected_entity_id);
-      igText("Body ID: %zu", entity->body_id);
+      igText("Entity ID: %u (gen %u)", handle_index(selected_entity),
+             handle_generation(selected_entity));
+      igText("Body ID: %u (gen %u)", handle_index(entity->body_id),
+             handle_generation(entity->body_id));
 
       LABELED_DRAG_FLOAT2("Position##ForEntity", body->aabb.position);
       LABELED_DRAG_FLOAT2("Velocity##ForEntity", body->velocity);
@@ -177,16 +289,16 @@ static void render_entity_inspector(void) {
       LABELED_CHECKBOX("Is Kinematic##ForEntity", &body->is_kinematic);
 
       if (igButton("Delete Entity", (ImVec2){-1, 0})) {
-        entity_deactivate(selected_entity_id);
-        selected_entity_id = -1;
+        entity_deactivate(selected_entity);
+        selected_entity = HANDLE_NONE;
       }
     }
   }
 }
 
-static const char* get_entity_name_for_body(size_t body_id) {
+static const char* get_entity_name_for_body(handle_t body_id) {
   for (size_t i = 0; i < entity_count(); ++i) {
-    entity_t* entity = entity_get(i);
+    entity_t* entity = entity_at(i);
     if (entity->is_active && entity->body_id == body_id) {
       return entity->name;
     }
@@ -195,7 +307,8 @@ static const char* get_entity_name_for_body(size_t body_id) {
   static int current_buffer = 0;
   char* buffer = buffers[current_buffer];
   current_buffer = (current_buffer + 1) % 32;
-  snprintf(buffer, sizeof(buffers[0]), "Body (No Entity) %zu", body_id);
+  snprintf(buffer, sizeof(buffers[0]), "Body (No Entity) %u",
+           handle_index(body_id));
   return buffer;
 }
 
@@ -203,24 +316,40 @@ static void render_physics_inspector(void) {
   if (igCollapsingHeader_TreeNodeFlags("Physics Inspector", NO_FLAGS)) {
     LABELED_SLIDER_FLOAT("Terminal", physics_get_terminal_velocity(), -7000.f,
                          0.f);
+    LABELED_SLIDER_FLOAT("Cell Size", physics_get_cell_size(), 4.f, 256.f);
+    LABELED_INPUT_U32("Iterations", physics_get_iterations());
+    LABELED_INPUT_U32("Sleep Ticks", physics_get_sleep_ticks());
+    LABELED_SLIDER_FLOAT("Sleep Speed", physics_get_sleep_threshold(), 0.f,
+                         50.f);
     igText("Body Count: %zu", physics_body_count());
     igText("Static Body Count: %zu", physics_static_body_count());
+    igText("Tilemaps: %zu", physics_tilemap_count());
+    igText("Pairs Tested: %u", physics_get_stats().pairs_tested);
+    igText("Threads: %u", physics_get_thread_count());
+    igText("Islands: %u", physics_get_stats().island_count);
+    igText("Sleeping: %u", physics_get_stats().sleeping_count);
+    igText("Clamped: %u", physics_get_stats().clamp_count);
+    igText("Contacts: %u", physics_get_stats().contact_count);
 
     igSeparator();
 
     // -- dynamic body selection --
-    const char* body_preview = (selected_body_id == -1)
+    if (!physics_body_is_valid(selected_body)) {
+      selected_body = HANDLE_NONE;
+    }
+    const char* body_preview = (selected_body == HANDLE_NONE)
                                    ? "None"
-                                   : get_entity_name_for_body(selected_body_id);
+                                   : get_entity_name_for_body(selected_body);
     LABELED_COMBO("Selected Body       ", body_preview, NO_FLAGS) {
-      OPTION_NONE { selected_entity_id = -1; }
+      OPTION_NONE { selected_entity = HANDLE_NONE; }
       for (size_t i = 0; i < physics_body_count(); ++i) {
-        body_t* body = physics_body_get(i);
+        body_t* body = physics_body_at(i);
         if (body->is_active) {
-          const char* name = get_entity_name_for_body(i);
-          if (igSelectable_Bool(name, selected_body_id == (int)i, 0,
+          handle_t handle = physics_body_handle_at(i);
+          const char* name = get_entity_name_for_body(handle);
+          if (igSelectable_Bool(name, selected_body == handle, 0,
                                 (ImVec2){0, 0})) {
-            selected_body_id = i;
+            selected_body = handle;
           }
         }
       }
@@ -234,7 +363,7 @@ static void render_physics_inspector(void) {
     const char* static_preview =
         selected_static_body_id == -1 ? "None" : static_body_label;
     LABELED_COMBO("Selected Static Body", static_preview, NO_FLAGS) {
-      OPTION_NONE { selected_entity_id = -1; }
+      OPTION_NONE { selected_entity = HANDLE_NONE; }
       for (size_t i = 0; i < physics_static_body_count(); ++i) {
         snprintf(static_body_label, sizeof(static_body_label),
                  "Static Body %zu", i);
@@ -249,10 +378,10 @@ static void render_physics_inspector(void) {
   }
 
   // -- selected body properties --
-  if (selected_body_id != -1) {
+  if (selected_body != HANDLE_NONE) {
     igSeparator();
     igText("Body Properties");
-    body_t* body = physics_body_get(selected_body_id);
+    body_t* body = physics_body_get(selected_body);
     LABELED_DRAG_FLOAT2("Position##ForBody", body->aabb.position);
     LABELED_DRAG_FLOAT2("Velocity##ForBody", body->velocity);
     LABELED_DRAG_FLOAT2("Accel##ForBody", body->acceleration);
@@ -260,6 +389,9 @@ static void render_physics_inspector(void) {
     LABELED_INPUT_U8("Collision Layer##ForBody", &body->collision_layer);
     LABELED_INPUT_U8("Collision Mask##ForBody", &body->collision_mask);
     LABELED_CHECKBOX("Is Kinematic##ForBody", &body->is_kinematic);
+    LABELED_CHECKBOX("Is Solid##ForBody", &body->is_solid);
+    LABELED_CHECKBOX("Always Awake##ForBody", &body->is_always_awake);
+    igText("Sleeping: %s", body->is_sleeping ? "yes" : "no");
   }
 
   // -- selected static body properties --
@@ -273,6 +405,8 @@ static void render_physics_inspector(void) {
                         static_body->aabb.half_size);
     LABELED_INPUT_U8("Collision Layer##ForStaticBody",
                      &static_body->collision_layer);
+    // the fields above may have been edited, refit the static bvh
+    physics_static_body_mark_dirty();
   }
 }
 
@@ -303,7 +437,7 @@ static void render_creation_tools(void) {
     if (igButton("Create Entity", (ImVec2){-1, 0})) {
       entity_create(new_entity_name, new_entity_pos, new_entity_size,
                     (vec2){0, 0}, NULL, 0, 0, new_entity_is_kinematic,
-                    (size_t)-1, NULL, NULL);
+                    HANDLE_NONE, NULL, NULL);
       increment_string_number(new_entity_name, sizeof(new_entity_name));
     }
 
@@ -321,6 +455,7 @@ static void render_creation_tools(void) {
 }
 
 void editor_update(void) {
+  PROFILE_SCOPE("editor update");
   imgui_new_frame();
 
   if (!is_visible) {
@@ -342,6 +477,7 @@ void editor_update(void) {
 }
 
 void editor_render(void) {
+  PROFILE_SCOPE("editor render");
   // render
   igRender();
   ImGui_ImplOpenGL3_RenderDrawData(igGetDrawData());
@@ -9,6 +9,7 @@
 #include "font/font.h"
 #include "io/input.h"
 #include "physics/physics.h"
+#include "profile/profile.h"
 #include "renderer/render.h"
 #include "state.h"
 #include "time/time.h"
@@ -2,54 +2,86 @@
 
 #include "../c-lib/dynlist.h"
 #include "../c-lib/log.h"
+#include "../c-lib/math.h"
 
 static DYNLIST(entity_t) entity_list;
+static DYNLIST(u32) entity_generations; // current generation of every slot
+static DYNLIST(u32) entity_free_list; // inactive slots, reused last in first out
 
 void entity_init(void) {
   entity_list = dynlist_create(entity_t);
+  entity_generations = dynlist_create(u32);
+  entity_free_list = dynlist_create(u32);
   LOG("Entity system initialized");
 }
 void entity_destroy(void) {
   dynlist_destroy(entity_list);
+  dynlist_destroy(entity_generations);
+  dynlist_destroy(entity_free_list);
   LOG("Entity system deinitialized");
 }
 
-void entity_deactivate(size_t idx) {
-  entity_t* entity = entity_get(idx);
+void entity_deactivate(handle_t handle) {
+  // stale handles are ignored so deactivating twice is harmless
+  if (!entity_is_valid(handle)) {
+    return;
+  }
+  u32 idx = handle_index(handle);
+  entity_t* entity = &entity_list[idx];
   entity->is_active = false;
+  entity_generations[idx] = handle_next_generation(entity_generations[idx]);
+  *dynlist_append(entity_free_list) = idx;
   physics_deactivate(entity->body_id);
 }
 
 size_t entity_count(void) { return dynlist_size(entity_list); }
 
-entity_t* entity_get(size_t idx) {
+bool entity_is_valid(handle_t handle) {
+  u32 idx = handle_index(handle);
+  return idx < dynlist_size(entity_generations) &&
+         entity_generations[idx] == handle_generation(handle);
+}
+
+entity_t* entity_get(handle_t handle) {
+  ASSERT(entity_is_valid(handle), "stale or invalid entity handle");
+  return &entity_list[handle_index(handle)];
+}
+
+entity_t* entity_at(size_t idx) {
   ASSERT(idx < dynlist_size(entity_list));
   return &entity_list[idx];
 }
 
-const char* entity_get_name(size_t idx) { return entity_get(idx)->name; }
+handle_t entity_handle_at(size_t idx) {
+  ASSERT(idx < dynlist_size(entity_list));
+  return handle_make(idx, entity_generations[idx]);
+}
 
-size_t entity_create(const char* name, vec2 position, vec2 size, vec2 velocity,
-                     vec2 acceleration, u8 collision_layer, u8 collision_mask,
-                     bool is_kinematic, size_t animation_id, on_hit_func on_hit,
-                     on_hit_static_func on_hit_static) {
-  size_t list_size = dynlist_size(entity_list);
-  size_t id = list_size;
-  for (size_t i = 0; i < list_size; ++i) {
-    entity_t* entity = &entity_list[i];
-    if (!entity->is_active) {
-      id = i;
-      break;
-    }
-  }
+const char* entity_get_name(handle_t handle) {
+  return entity_get(handle)->name;
+}
 
-  if (id == list_size) {
-    *dynlist_append(entity_list) = (entity_t){0};
+static size_t entity_alloc(void) {
+  // dynlist_pop reallocates on every call, shrinking by hand keeps this O(1)
+  size_t free_count = dynlist_size(entity_free_list);
+  if (free_count > 0) {
+    size_t idx = entity_free_list[free_count - 1];
+    dynlist_resize_no_contract(entity_free_list, free_count - 1);
+    return idx;
   }
+  *dynlist_append(entity_list) = (entity_t){0};
+  *dynlist_append(entity_generations) = 1;
+  return dynlist_size(entity_list) - 1;
+}
 
-  entity_t* entity = entity_get(id);
+handle_t entity_create(const char* name, vec2 position, vec2 size,
+                       vec2 velocity, vec2 acceleration, u8 collision_layer,
+                       u8 collision_mask, bool is_kinematic,
+                       handle_t animation_id, on_hit_func on_hit,
+                       on_hit_static_func on_hit_static) {
+  size_t idx = entity_alloc();
 
-  *entity = (entity_t){
+  entity_list[idx] = (entity_t){
       .body_id = physics_body_create(position, size, velocity, acceleration,
                                      collision_layer, collision_mask,
                                      is_kinematic, on_hit, on_hit_static),
@@ -58,5 +90,36 @@ size_t entity_create(const char* name, vec2 position, vec2 size, vec2 velocity,
       .name = name,
   };
 
-  return id;
+  return handle_make(idx, entity_generations[idx]);
+}
+
+void entity_create_n(size_t count, handle_t* handles, const char* name,
+                     vec2 position, vec2 size, vec2 velocity,
+                     vec2 acceleration, u8 collision_layer, u8 collision_mask,
+                     bool is_kinematic, handle_t animation_id,
+                     on_hit_func on_hit, on_hit_static_func on_hit_static) {
+  size_t free_count = dynlist_size(entity_free_list);
+  size_t needed = dynlist_size(entity_list) + (count - min(count, free_count));
+  if (dynlist_capacity(entity_list) < needed) {
+    dynlist_ensure(entity_list, needed);
+  }
+  if (dynlist_capacity(entity_generations) < needed) {
+    dynlist_ensure(entity_generations, needed);
+  }
+
+  // the bodies are created in bulk first so both lists only grow once, their
+  // handles are swapped for the entity handles as they are created
+  physics_body_create_n(count, handles, position, size, velocity,
+                        acceleration, collision_layer, collision_mask,
+                        is_kinematic, on_hit, on_hit_static);
+  for (size_t i = 0; i < count; ++i) {
+    size_t idx = entity_alloc();
+    entity_list[idx] = (entity_t){
+        .body_id = handles[i],
+        .animation_id = animation_id,
+        .is_active = true,
+        .name = name,
+    };
+    handles[i] = handle_make(idx, entity_generations[idx]);
+  }
 }
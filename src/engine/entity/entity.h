@@ -1,24 +1,39 @@
 #pragma once
 
+#include "../c-lib/handle.h"
 #include "../c-lib/types.h"
 #include "../math/math.h"
 #include "../physics/physics.h"
 
 typedef struct entity {
-  size_t body_id;
-  size_t animation_id;
+  handle_t body_id;
+  handle_t animation_id; // HANDLE_NONE when it has no animation
   bool is_active;
   const char* name;
 } entity_t;
 
 void entity_init(void);
 void entity_destroy(void);
-void entity_deactivate(size_t idx);
+void entity_deactivate(handle_t entity);
 
+// entities are referred to by generational handles like bodies, pointers are
+// only good until the next entity is created
 size_t entity_count(void);
-entity_t* entity_get(size_t idx);
-const char* entity_get_name(size_t idx);
-size_t entity_create(const char* name, vec2 position, vec2 size, vec2 velocity,
+bool entity_is_valid(handle_t entity);
+entity_t* entity_get(handle_t entity);
+// slot access for walking every entity (active or not) by index
+entity_t* entity_at(size_t idx);
+handle_t entity_handle_at(size_t idx);
+const char* entity_get_name(handle_t entity);
+handle_t entity_create(const char* name, vec2 position, vec2 size,
+                       vec2 velocity, vec2 acceleration, u8 collision_layer,
+                       u8 collision_mask, bool is_kinematic,
+                       handle_t animation_id, on_hit_func on_hit,
+                       on_hit_static_func on_hit_static);
+// creates count identical entities (each with its own body), writing their
+// handles to handles. the entity and body lists grow at most once each.
+void entity_create_n(size_t count, handle_t* handles, const char* name,
+                     vec2 position, vec2 size, vec2 velocity,
                      vec2 acceleration, u8 collision_layer, u8 collision_mask,
-                     bool is_kinematic, size_t animation_id, on_hit_func on_hit,
-                     on_hit_static_func on_hit_static);
+                     bool is_kinematic, handle_t animation_id,
+                     on_hit_func on_hit, on_hit_static_func on_hit_static);
@@ -2,6 +2,7 @@
 
 #include "../c-lib/misc.h"
 #include "../math/math.h"
+#include "../profile/profile.h"
 #include "../renderer/render.h"
 
 static iv2 find_char(char ch) {
@@ -32,6 +33,7 @@ void font_render_char(sprite_sheet_t* font_sheet, char ch, vec2 position,
 
 void font_render_str(sprite_sheet_t* font_sheet, const char* str, vec2 position,
                      vec2 size, vec4 color) {
+  PROFILE_SCOPE("font");
   if (size == NULL) {
     size = (vec2){font_sheet->cell_width, font_sheet->cell_height};
   }
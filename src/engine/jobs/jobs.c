@@ -0,0 +1,140 @@
+#include "jobs.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../c-lib/dynlist.h"
+#include "../c-lib/log.h"
+#include "../c-lib/math.h"
+
+typedef struct {
+  jobs_func func;
+  void* data;
+  u32 count;
+  u32 batch_size;
+  u32 next;   // first item not yet taken, advanced atomically
+  u32 active; // workers still inside the current job
+} job_t;
+
+static DYNLIST(pthread_t) thread_list;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static job_t job;
+static u32 generation; // bumped for every job so sleeping workers notice
+static u32 init_generation; // jobs already run before the pool was created
+static bool is_quitting;
+
+static void run_batches(u32 worker) {
+  for (;;) {
+    u32 begin = __atomic_fetch_add(&job.next, job.batch_size, __ATOMIC_RELAXED);
+    if (begin >= job.count) {
+      return;
+    }
+    job.func(job.data, begin, min(begin + job.batch_size, job.count), worker);
+  }
+}
+
+static void* worker_main(void* arg) {
+  u32 worker = (u32)(size_t)arg;
+  u32 seen = init_generation;
+
+  pthread_mutex_lock(&mutex);
+  for (;;) {
+    while (generation == seen && !is_quitting) {
+      pthread_cond_wait(&start_cond, &mutex);
+    }
+    if (is_quitting) {
+      break;
+    }
+    seen = generation;
+    pthread_mutex_unlock(&mutex);
+
+    run_batches(worker);
+
+    pthread_mutex_lock(&mutex);
+    if (--job.active == 0) {
+      pthread_cond_signal(&done_cond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return NULL;
+}
+
+void jobs_init(u32 thread_count) {
+  if (thread_list != NULL) {
+    jobs_destroy();
+  }
+
+  if (thread_count == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = cpus > 0 ? (u32)cpus : 1;
+  }
+
+  // the calling thread is worker 0, the pool only holds the others
+  thread_list = dynlist_create(pthread_t, thread_count);
+  is_quitting = false;
+  init_generation = generation;
+  for (u32 i = 1; i < thread_count; ++i) {
+    pthread_t* thread = dynlist_append(thread_list);
+    if (pthread_create(thread, NULL, worker_main, (void*)(size_t)i) != 0) {
+      ERROR("failed to create worker thread %u", i);
+      dynlist_pop(thread_list);
+      break;
+    }
+  }
+
+  LOG("Job system initialized with %u threads", jobs_thread_count());
+}
+
+void jobs_destroy(void) {
+  if (thread_list == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  is_quitting = true;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&mutex);
+
+  dynlist_each(thread_list, thread) { pthread_join(*thread, NULL); }
+  dynlist_destroy(thread_list);
+  LOG("Job system deinitialized");
+}
+
+u32 jobs_thread_count(void) { return dynlist_size(thread_list) + 1; }
+
+void jobs_parallel_for(jobs_func func, void* data, u32 count, u32 batch_size) {
+  if (count == 0) {
+    return;
+  }
+  batch_size = max(batch_size, 1u);
+
+  // not worth waking anyone for a single batch
+  u32 worker_count = dynlist_size(thread_list);
+  if (worker_count == 0 || count <= batch_size) {
+    func(data, 0, count, 0);
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  job = (job_t){
+      .func = func,
+      .data = data,
+      .count = count,
+      .batch_size = batch_size,
+      .active = worker_count,
+  };
+  ++generation;
+  pthread_cond_broadcast(&start_cond);
+  pthread_mutex_unlock(&mutex);
+
+  run_batches(0);
+
+  pthread_mutex_lock(&mutex);
+  while (job.active > 0) {
+    pthread_cond_wait(&done_cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
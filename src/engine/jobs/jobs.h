@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../c-lib/types.h"
+
+// work run over [begin, end) of a parallel for. worker is in
+// [0, jobs_thread_count()) and can index per thread scratch data, the calling
+// thread always runs as worker 0.
+typedef void (*jobs_func)(void* data, u32 begin, u32 end, u32 worker);
+
+// thread_count includes the calling thread, 0 uses one per online cpu.
+// without a pool (or with a count of 1) every job runs on the calling thread.
+void jobs_init(u32 thread_count);
+void jobs_destroy(void);
+u32 jobs_thread_count(void);
+
+// splits [0, count) into runs of up to batch_size items that the workers take
+// in turn, returns once every item has been processed
+void jobs_parallel_for(jobs_func func, void* data, u32 count, u32 batch_size);
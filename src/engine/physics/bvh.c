@@ -0,0 +1,256 @@
+#include "bvh.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "../c-lib/math.h"
+#include "../c-lib/misc.h"
+
+static int cmp_u32(const void* a, const void* b) {
+  u32 x = *(const u32*)a, y = *(const u32*)b;
+  return (x > y) - (x < y);
+}
+
+static bvh_bounds_t bounds_union(bvh_bounds_t a, bvh_bounds_t b) {
+  return (bvh_bounds_t){
+      .min = {min(a.min[0], b.min[0]), min(a.min[1], b.min[1])},
+      .max = {max(a.max[0], b.max[0]), max(a.max[1], b.max[1])},
+  };
+}
+
+static bool bounds_overlap(bvh_bounds_t b, vec2 min, vec2 max) {
+  return b.min[0] <= max[0] && b.max[0] >= min[0] && b.min[1] <= max[1] &&
+         b.max[1] >= min[1];
+}
+
+static bool bounds_ray(bvh_bounds_t b, vec2 origin, vec2 magnitude,
+                       vec2 padding) {
+  // slab test clipped to the segment, inclusive so it never rejects anything
+  // that ray_intersect_aabb could report as a hit
+  f32 t_enter = 0.0f, t_exit = 1.0f;
+  for (u8 i = 0; i < 2; ++i) {
+    f32 lo = b.min[i] - padding[i];
+    f32 hi = b.max[i] + padding[i];
+    if (!(fabsf(magnitude[i]) > 0.0f)) {
+      if (origin[i] < lo || origin[i] > hi) {
+        return false;
+      }
+      continue;
+    }
+    f32 inv = 1.0f / magnitude[i];
+    f32 t1 = (lo - origin[i]) * inv;
+    f32 t2 = (hi - origin[i]) * inv;
+    t_enter = fmaxf(t_enter, fminf(t1, t2));
+    t_exit = fminf(t_exit, fmaxf(t1, t2));
+  }
+  return t_enter <= t_exit;
+}
+
+void bvh_init(bvh_t* bvh) {
+  *bvh = (bvh_t){
+      .nodes = dynlist_create(bvh_node_t),
+      .indices = dynlist_create(u32),
+      .items = dynlist_create(bvh_bounds_t),
+  };
+}
+
+void bvh_destroy(bvh_t* bvh) {
+  dynlist_destroy(bvh->nodes);
+  dynlist_destroy(bvh->indices);
+  dynlist_destroy(bvh->items);
+}
+
+void bvh_build_begin(bvh_t* bvh, size_t count) {
+  dynlist_resize(bvh->items, count);
+  for (size_t i = 0; i < count; ++i) {
+    bvh->items[i] = (bvh_bounds_t){0};
+  }
+}
+
+void bvh_set(bvh_t* bvh, u32 id, vec2 min, vec2 max) {
+  ASSERT(id < dynlist_size(bvh->items));
+  bvh->items[id] = (bvh_bounds_t){
+      .min = {min[0], min[1]},
+      .max = {max[0], max[1]},
+  };
+}
+
+static f32 item_center(bvh_t* bvh, u32 id, u8 axis) {
+  return bvh->items[id].min[axis] + bvh->items[id].max[axis];
+}
+
+// partially sorts indices[lo, hi) so the kth slot holds the median on axis,
+// with smaller centers to its left and larger to its right
+static void select_median(bvh_t* bvh, u32 lo, u32 hi, u32 k, u8 axis) {
+  u32* idx = bvh->indices;
+  while (hi - lo > 1) {
+    f32 pivot = item_center(bvh, idx[(lo + hi) / 2], axis);
+    u32 i = lo, j = hi - 1;
+    while (i <= j) {
+      while (item_center(bvh, idx[i], axis) < pivot) ++i;
+      while (item_center(bvh, idx[j], axis) > pivot) --j;
+      if (i <= j) {
+        u32 tmp = idx[i];
+        idx[i] = idx[j];
+        idx[j] = tmp;
+        ++i;
+        if (j == 0) break;
+        --j;
+      }
+    }
+    if (k <= j) {
+      hi = j + 1;
+    } else if (k >= i) {
+      lo = i;
+    } else {
+      return;
+    }
+  }
+}
+
+static void build_node(bvh_t* bvh, u32 node_id, u32 first, u32 count) {
+  bvh_bounds_t bounds = bvh->items[bvh->indices[first]];
+  bvh_bounds_t centers = {
+      .min = {item_center(bvh, bvh->indices[first], 0),
+              item_center(bvh, bvh->indices[first], 1)},
+  };
+  centers.max[0] = centers.min[0];
+  centers.max[1] = centers.min[1];
+  for (u32 i = first + 1; i < first + count; ++i) {
+    u32 id = bvh->indices[i];
+    bounds = bounds_union(bounds, bvh->items[id]);
+    f32 cx = item_center(bvh, id, 0), cy = item_center(bvh, id, 1);
+    centers.min[0] = min(centers.min[0], cx);
+    centers.min[1] = min(centers.min[1], cy);
+    centers.max[0] = max(centers.max[0], cx);
+    centers.max[1] = max(centers.max[1], cy);
+  }
+
+  bvh->nodes[node_id] = (bvh_node_t){
+      .bounds = bounds,
+      .first = first,
+      .count = count,
+  };
+  if (count <= BVH_LEAF_SIZE) {
+    return;
+  }
+
+  // split at the median of the longest axis of the item centers
+  u8 axis = (centers.max[0] - centers.min[0]) <
+            (centers.max[1] - centers.min[1]);
+  u32 half = count / 2;
+  select_median(bvh, first, first + count, first + half, axis);
+
+  // children are allocated as a pair, appending may move the node list
+  u32 left = dynlist_size(bvh->nodes);
+  *dynlist_append(bvh->nodes) = (bvh_node_t){0};
+  *dynlist_append(bvh->nodes) = (bvh_node_t){0};
+  bvh->nodes[node_id].first = left;
+  bvh->nodes[node_id].count = 0;
+
+  build_node(bvh, left, first, half);
+  build_node(bvh, left + 1, first + half, count - half);
+}
+
+void bvh_build_end(bvh_t* bvh) {
+  size_t count = dynlist_size(bvh->items);
+  dynlist_clear(bvh->nodes);
+  dynlist_resize(bvh->indices, count);
+  if (count == 0) {
+    return;
+  }
+
+  for (u32 i = 0; i < count; ++i) {
+    bvh->indices[i] = i;
+  }
+  dynlist_ensure(bvh->nodes, 2 * (count / BVH_LEAF_SIZE + 1));
+  *dynlist_append(bvh->nodes) = (bvh_node_t){0};
+  build_node(bvh, 0, 0, count);
+}
+
+void bvh_refit(bvh_t* bvh) {
+  ASSERT(dynlist_size(bvh->indices) == dynlist_size(bvh->items),
+         "bvh_refit needs the same items the tree was built with");
+
+  // children always come after their parent, so walking backwards visits
+  // every child before the node that contains it
+  for (size_t n = dynlist_size(bvh->nodes); n-- > 0;) {
+    bvh_node_t* node = &bvh->nodes[n];
+    if (node->count > 0) {
+      node->bounds = bvh->items[bvh->indices[node->first]];
+      for (u32 i = node->first + 1; i < node->first + node->count; ++i) {
+        node->bounds = bounds_union(node->bounds, bvh->items[bvh->indices[i]]);
+      }
+    } else {
+      node->bounds = bounds_union(bvh->nodes[node->first].bounds,
+                                  bvh->nodes[node->first + 1].bounds);
+    }
+  }
+}
+
+size_t bvh_query(bvh_t* bvh, vec2 min, vec2 max, u32** out) {
+  size_t first = dynlist_size(*out);
+  if (dynlist_size(bvh->nodes) == 0) {
+    return 0;
+  }
+
+  u32 stack[BVH_MAX_DEPTH];
+  u32 top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    bvh_node_t* node = &bvh->nodes[stack[--top]];
+    if (!bounds_overlap(node->bounds, min, max)) {
+      continue;
+    }
+    if (node->count == 0) {
+      ASSERT(top + 2 <= BVH_MAX_DEPTH, "bvh is too deep");
+      stack[top++] = node->first + 1;
+      stack[top++] = node->first;
+      continue;
+    }
+    for (u32 i = node->first; i < node->first + node->count; ++i) {
+      u32 id = bvh->indices[i];
+      if (bounds_overlap(bvh->items[id], min, max)) {
+        *dynlist_append(*out) = id;
+      }
+    }
+  }
+
+  size_t added = dynlist_size(*out) - first;
+  qsort(*out + first, added, sizeof(u32), cmp_u32);
+  return added;
+}
+
+size_t bvh_query_ray(bvh_t* bvh, vec2 origin, vec2 magnitude, vec2 padding,
+                     u32** out) {
+  size_t first = dynlist_size(*out);
+  if (dynlist_size(bvh->nodes) == 0) {
+    return 0;
+  }
+
+  u32 stack[BVH_MAX_DEPTH];
+  u32 top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    bvh_node_t* node = &bvh->nodes[stack[--top]];
+    if (!bounds_ray(node->bounds, origin, magnitude, padding)) {
+      continue;
+    }
+    if (node->count == 0) {
+      ASSERT(top + 2 <= BVH_MAX_DEPTH, "bvh is too deep");
+      stack[top++] = node->first + 1;
+      stack[top++] = node->first;
+      continue;
+    }
+    for (u32 i = node->first; i < node->first + node->count; ++i) {
+      u32 id = bvh->indices[i];
+      if (bounds_ray(bvh->items[id], origin, magnitude, padding)) {
+        *dynlist_append(*out) = id;
+      }
+    }
+  }
+
+  size_t added = dynlist_size(*out) - first;
+  qsort(*out + first, added, sizeof(u32), cmp_u32);
+  return added;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../c-lib/dynlist.h"
+#include "../c-lib/types.h"
+#include "../math/math.h"
+
+// bounding volume hierarchy over items that rarely move (static bodies).
+// items are referenced by their index in the owning list.
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 64
+
+typedef struct {
+  vec2 min, max;
+} bvh_bounds_t;
+
+typedef struct {
+  bvh_bounds_t bounds;
+  u32 first; // leaf: first slot in indices, inner: left child (right is +1)
+  u32 count; // leaf: item count, zero for inner nodes
+} bvh_node_t;
+
+typedef struct {
+  DYNLIST(bvh_node_t) nodes;  // nodes[0] is the root when there are items
+  DYNLIST(u32) indices;       // item ids, grouped so each leaf owns a range
+  DYNLIST(bvh_bounds_t) items; // bounds of every item by id
+} bvh_t;
+
+void bvh_init(bvh_t* bvh);
+void bvh_destroy(bvh_t* bvh);
+
+// building: begin with the item count, set the bounds of every item, then
+// end to build the tree. bvh_refit can be used instead of ending a build when
+// only the bounds of the same items changed, it keeps the tree topology.
+void bvh_build_begin(bvh_t* bvh, size_t count);
+void bvh_set(bvh_t* bvh, u32 id, vec2 min, vec2 max);
+void bvh_build_end(bvh_t* bvh);
+void bvh_refit(bvh_t* bvh);
+
+// both queries append the matching ids to out in ascending order so results
+// match a linear scan, and return the count added.
+// items overlapping [min, max]
+size_t bvh_query(bvh_t* bvh, vec2 min, vec2 max, u32** out);
+// items whose bounds, grown by padding on every side, are touched by the
+// segment from origin to origin + magnitude
+size_t bvh_query_ray(bvh_t* bvh, vec2 origin, vec2 magnitude, vec2 padding,
+                     u32** out);
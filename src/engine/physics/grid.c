@@ -0,0 +1,184 @@
+#include "grid.h"
+
+#include <stdlib.h>
+
+#include "../c-lib/math.h"
+#include "../c-lib/misc.h"
+
+#define GRID_MIN_BUCKETS 64
+
+static u32 cell_hash(i32 x, i32 y) {
+  return ((u32)x * 73856093u) ^ ((u32)y * 19349663u);
+}
+
+static i32 cell_coord(f32 v, f32 cell_size) {
+  return (i32)floorf(v / cell_size);
+}
+
+static u64 range_cell_count(grid_range_t r) {
+  return (u64)(r.x1 - r.x0 + 1) * (u64)(r.y1 - r.y0 + 1);
+}
+
+static bool bounds_overlap(grid_bounds_t b, vec2 min, vec2 max) {
+  return b.min[0] <= max[0] && b.max[0] >= min[0] && b.min[1] <= max[1] &&
+         b.max[1] >= min[1];
+}
+
+static int cmp_u32(const void* a, const void* b) {
+  u32 x = *(const u32*)a, y = *(const u32*)b;
+  return (x > y) - (x < y);
+}
+
+void grid_init(grid_t* grid) {
+  *grid = (grid_t){
+      .bucket_start = dynlist_create(u32, GRID_MIN_BUCKETS + 2),
+      .entries = dynlist_create(u32),
+      .large = dynlist_create(u32),
+      .ranges = dynlist_create(grid_range_t),
+      .bounds = dynlist_create(grid_bounds_t),
+  };
+  grid_build_begin(grid, 0, 1.0f);
+  grid_build_end(grid);
+}
+
+void grid_destroy(grid_t* grid) {
+  dynlist_destroy(grid->bucket_start);
+  dynlist_destroy(grid->entries);
+  dynlist_destroy(grid->large);
+  dynlist_destroy(grid->ranges);
+  dynlist_destroy(grid->bounds);
+}
+
+void grid_build_begin(grid_t* grid, size_t count, f32 cell_size) {
+  ASSERT(cell_size > 0.0f, "grid cell size must be positive");
+  grid->cell_size = cell_size;
+
+  dynlist_resize(grid->ranges, count);
+  dynlist_resize(grid->bounds, count);
+  for (size_t i = 0; i < count; ++i) {
+    grid->ranges[i] = (grid_range_t){0, 0, -1, -1};
+  }
+}
+
+void grid_set(grid_t* grid, u32 id, vec2 min, vec2 max) {
+  ASSERT(id < dynlist_size(grid->ranges));
+  grid->ranges[id] = (grid_range_t){
+      .x0 = cell_coord(min[0], grid->cell_size),
+      .y0 = cell_coord(min[1], grid->cell_size),
+      .x1 = cell_coord(max[0], grid->cell_size),
+      .y1 = cell_coord(max[1], grid->cell_size),
+  };
+  grid->bounds[id] = (grid_bounds_t){
+      .min = {min[0], min[1]},
+      .max = {max[0], max[1]},
+  };
+}
+
+void grid_build_end(grid_t* grid) {
+  size_t count = dynlist_size(grid->ranges);
+
+  // roughly two buckets per item keeps the chains short
+  u32 bucket_count = GRID_MIN_BUCKETS;
+  while (bucket_count < count * 2) {
+    bucket_count <<= 1;
+  }
+  grid->bucket_mask = bucket_count - 1;
+
+  // counts are stored two ahead so the prefix sum can double as fill cursors,
+  // leaving bucket b in [bucket_start[b], bucket_start[b + 1])
+  dynlist_resize(grid->bucket_start, bucket_count + 2);
+  memset(grid->bucket_start, 0, (bucket_count + 2) * sizeof(u32));
+  dynlist_clear(grid->large);
+
+  for (size_t id = 0; id < count; ++id) {
+    grid_range_t* r = &grid->ranges[id];
+    if (r->x0 > r->x1) {
+      continue;
+    }
+    if (range_cell_count(*r) > bucket_count) {
+      // it would land in every bucket anyway, so keep it on the side
+      *dynlist_append(grid->large) = id;
+      *r = (grid_range_t){0, 0, -1, -1};
+      continue;
+    }
+    for (i32 y = r->y0; y <= r->y1; ++y) {
+      for (i32 x = r->x0; x <= r->x1; ++x) {
+        grid->bucket_start[(cell_hash(x, y) & grid->bucket_mask) + 2]++;
+      }
+    }
+  }
+
+  for (u32 b = 1; b < bucket_count + 2; ++b) {
+    grid->bucket_start[b] += grid->bucket_start[b - 1];
+  }
+  dynlist_resize(grid->entries, grid->bucket_start[bucket_count + 1]);
+
+  for (size_t id = 0; id < count; ++id) {
+    grid_range_t r = grid->ranges[id];
+    for (i32 y = r.y0; y <= r.y1; ++y) {
+      for (i32 x = r.x0; x <= r.x1; ++x) {
+        u32 b = cell_hash(x, y) & grid->bucket_mask;
+        grid->entries[grid->bucket_start[b + 1]++] = id;
+      }
+    }
+  }
+}
+
+size_t grid_query(const grid_t* grid, vec2 min, vec2 max, u32** out) {
+  size_t first = dynlist_size(*out);
+
+  grid_range_t r = {
+      .x0 = cell_coord(min[0], grid->cell_size),
+      .y0 = cell_coord(min[1], grid->cell_size),
+      .x1 = cell_coord(max[0], grid->cell_size),
+      .y1 = cell_coord(max[1], grid->cell_size),
+  };
+
+  // buckets also hold the items of other cells that hash the same, and the
+  // large items are not bucketed at all, so everything found is tested
+  // against the query bounds before it is added
+  if (range_cell_count(r) > grid->bucket_mask + 1) {
+    // the query covers more cells than there are buckets, visit all of them
+    for (size_t e = 0; e < dynlist_size(grid->entries); ++e) {
+      u32 id = grid->entries[e];
+      if (bounds_overlap(grid->bounds[id], min, max)) {
+        *dynlist_append(*out) = id;
+      }
+    }
+  } else {
+    for (i32 y = r.y0; y <= r.y1; ++y) {
+      for (i32 x = r.x0; x <= r.x1; ++x) {
+        u32 b = cell_hash(x, y) & grid->bucket_mask;
+        for (u32 e = grid->bucket_start[b]; e < grid->bucket_start[b + 1];
+             ++e) {
+          u32 id = grid->entries[e];
+          if (bounds_overlap(grid->bounds[id], min, max)) {
+            *dynlist_append(*out) = id;
+          }
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < dynlist_size(grid->large); ++i) {
+    u32 id = grid->large[i];
+    if (bounds_overlap(grid->bounds[id], min, max)) {
+      *dynlist_append(*out) = id;
+    }
+  }
+
+  // items spanning several cells are found once per cell, sorting brings the
+  // copies together. the grid is never written here so that queries can run
+  // from several threads at once.
+  size_t added = dynlist_size(*out) - first;
+  u32* ids = *out + first;
+  qsort(ids, added, sizeof(u32), cmp_u32);
+  size_t unique = 0;
+  for (size_t i = 0; i < added; ++i) {
+    if (unique == 0 || ids[i] != ids[unique - 1]) {
+      ids[unique++] = ids[i];
+    }
+  }
+  dynlist_resize_no_contract(*out, first + unique);
+  return unique;
+}
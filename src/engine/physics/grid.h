@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../c-lib/dynlist.h"
+#include "../c-lib/types.h"
+#include "../math/math.h"
+
+// uniform grid broad phase, stored as a spatial hash so that the world does not
+// need fixed bounds. items are referenced by their index in the owning list.
+typedef struct {
+  i32 x0, y0, x1, y1; // inclusive cell range, empty when x0 > x1
+} grid_range_t;
+
+typedef struct {
+  vec2 min, max;
+} grid_bounds_t;
+
+typedef struct {
+  f32 cell_size;
+  u32 bucket_mask;
+  DYNLIST(u32) bucket_start;     // bucket_mask + 2 prefix sums into entries
+  DYNLIST(u32) entries;          // item ids grouped by bucket
+  DYNLIST(u32) large;            // items spanning more cells than buckets
+  DYNLIST(grid_range_t) ranges;  // one per item
+  DYNLIST(grid_bounds_t) bounds; // one per item, to filter what a cell holds
+} grid_t;
+
+void grid_init(grid_t* grid);
+void grid_destroy(grid_t* grid);
+
+// rebuilding: begin with the item count, set the bounds of every item that
+// should be present (unset items are skipped), then end to bucket them.
+void grid_build_begin(grid_t* grid, size_t count, f32 cell_size);
+void grid_set(grid_t* grid, u32 id, vec2 min, vec2 max);
+void grid_build_end(grid_t* grid);
+
+// appends the ids of all items whose bounds overlap [min, max] to out, in
+// ascending order so the results match a linear scan. returns the count added.
+// safe to call from several threads as long as nothing is building the grid.
+size_t grid_query(const grid_t* grid, vec2 min, vec2 max, u32** out);
@@ -1,103 +1,953 @@
 #include "physics.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "../c-lib/dynlist.h"
 #include "../c-lib/log.h"
 #include "../c-lib/math.h"
-#include "../renderer/render.h"
+#include "../jobs/jobs.h"
+#include "../profile/profile.h"
+#include "bvh.h"
+#include "grid.h"
+#include "sap.h"
+#include "soa.h"
 
 static f32 terminal_velocity;
 static DYNLIST(body_t) body_list;
+static DYNLIST(u32) body_generations; // current generation of every slot
+static DYNLIST(u32) body_free_list; // inactive slots, reused last in first out
+
+// callbacks are only read when dispatching hits, keeping them out of body_list
+// keeps the records the solver walks small and out of the snapshots. one per
+// slot and never shrunk, so a restore that drops slots keeps them around.
+typedef struct {
+  on_hit_func on_hit;
+  on_hit_static_func on_hit_static;
+} body_callbacks_t;
+
+static DYNLIST(body_callbacks_t) body_callbacks;
 static DYNLIST(static_body_t) static_body_list;
+
+// the tiles of every map are kept in one list, a map's tile ids start at
+// first and run row by row from its bottom row
+typedef struct {
+  vec2 origin;
+  vec2 tile_size;
+  u32 width, height;
+  size_t first;
+  u8 layers[256]; // collision layer of each tile id
+} tilemap_t;
+
+static DYNLIST(tilemap_t) tilemap_list;
+static DYNLIST(u8) tile_list;
 static u32 iterations = 2; // computation/accurate collisions
 static f32 tick_rate;
+static f32 fixed_delta; // deterministic mode tick, 0 when off
+
+// broad phase, the bodies are put in the one picked at init at the start of
+// every update while the static bvh is only rebuilt (or refit) once the static
+// bodies are dirty
+static broad_phase_t broad_phase;
+static f32 cell_size;
+static grid_t body_grid;
+static sap_t body_sap;
+static DYNLIST(u32) body_brute_ids; // bodies in BROAD_PHASE_BRUTE, ascending
+static bvh_t static_bvh;
+static bool is_static_bvh_dirty;
+static DYNLIST(aabb_t) body_fat_aabbs; // what each body can reach this update
+static physics_stats_t stats;
+
+// bodies asleep when the broad phase was built. a body woken in the middle of
+// an update keeps its fat aabb from the start of it, so it only moves again
+// from the next one.
+static DYNLIST(bool) body_asleep;
+static DYNLIST(aabb_t) static_changes; // old and new bounds of moved statics
+static u32 sleep_ticks;
+static f32 sleep_threshold;
+
+typedef struct {
+  vec2 min, max;
+} bounds_t;
+
+static bounds_t world_bounds;
+static bounds_t layer_bounds[8]; // by layer bit
+static u8 layer_bounds_mask;     // layers with bounds of their own
+
+// compact copies of the candidate side of the sweeps, see soa.h
+static aabb_soa_t body_soa;
+static aabb_soa_t static_soa;
+
+typedef struct {
+  u32 self;
+  u32 other;
+  hit_t hit;
+  u8 kind; // collision_kind_t
+} deferred_hit_t;
+
+// scratch for one thread running the solver. in parallel mode bodies only see
+// the other bodies of their island and callbacks are queued instead of run.
+typedef struct {
+  DYNLIST(u32) candidate_list;
+  // statics found by the last static sweep, still good for depenetrating
+  // while the body ends up on that sweep's path (is_on_static_sweep)
+  DYNLIST(u32) static_list;
+  DYNLIST(deferred_hit_t) hit_list;
+  DYNLIST(u32) link_list; // pairs of bodies that have to share an island
+  DYNLIST(u32) escaped_list; // bodies that ended up outside their fat aabb
+  u32 pairs_tested;
+  u32 clamp_count;
+  u32 island;
+  bool is_parallel;
+  bool is_on_static_sweep;
+} solver_t;
+
+// persistent pair cache, an open addressed hash table keyed by the handles of
+// the pair (the static body index or tile id for static and tile contacts). a
+// contact lives from the first hit of a pair until an update without one,
+// except for sleeping bodies which do not sweep and keep what they rested on
+// until they wake.
+typedef struct {
+  handle_t self;
+  u64 other;
+  hit_t hit;      // the pair's first hit of the last update it touched
+  u32 tick;       // last update the pair touched
+  u8 other_layer; // collision layer of the other side at that time
+  u8 slot;        // CONTACT_SLOT_*
+  u8 kind;        // collision_kind_t
+} contact_t;
+
+enum {
+  CONTACT_SLOT_EMPTY,
+  CONTACT_SLOT_USED,
+  CONTACT_SLOT_REMOVED, // tombstone, probing continues past it
+};
+
+// what a body touches, rebuilt from the cache after every update
+typedef struct {
+  u32 generation;
+  u8 layers;
+  u8 directions[8]; // by layer bit, CONTACT_UP etc. of the contacts
+} touching_t;
+
+static DYNLIST(contact_t) contact_table; // capacity is a power of two
+static DYNLIST(contact_t) contact_scratch; // old table while growing
+static u32 contact_count;
+static u32 contact_removed;
+static u32 contact_tick;
+static DYNLIST(touching_t) body_touching;
+static DYNLIST(collision_event_t) event_list;
+
+typedef struct {
+  DYNLIST(body_t) body_list;
+  DYNLIST(u32) body_generations;
+  DYNLIST(u32) body_free_list;
+  DYNLIST(static_body_t) static_body_list;
+  DYNLIST(tilemap_t) tilemap_list;
+  DYNLIST(u8) tile_list;
+  DYNLIST(contact_t) contact_table;
+  DYNLIST(touching_t) body_touching;
+  u32 contact_count, contact_removed, contact_tick;
+  u32 id;
+  bool is_saved;
+} snapshot_t;
+
+static DYNLIST(snapshot_t) snapshot_ring;
+static u32 snapshot_next_id;
+
+// bodies that can reach each other, solved in order on a single worker
+typedef struct {
+  u32 first, count;         // range of island_bodies
+  u32 worker;               // solver that ran the island and holds its hits
+  u32 hit_first, hit_count; // range of that solver's hit_list
+  bool has_awake;           // islands of sleepers only are not solved
+} island_t;
+
+// ids from the broad phase for the spatial queries, kept between calls so
+// querying does not allocate once it has grown
+static DYNLIST(u32) query_list;
+
+static u32 thread_count = 1;
+static DYNLIST(solver_t) solver_list; // one per job thread
+static DYNLIST(island_t) island_list;
+static DYNLIST(u32) island_bodies; // body ids grouped by island
+static DYNLIST(u32) body_island;   // island of each body, -1 if not solved
+static DYNLIST(u32) island_parent; // union-find forest over the bodies
 
 #define DEFAULT_ACCEL_X 0
 #define DEFAULT_ACCEL_Y -10
+#define DEFAULT_CELL_SIZE 32
+#define DEFAULT_SLEEP_TICKS 30
+#define DEFAULT_SLEEP_THRESHOLD 1
+#define STATIC_WAKE_MARGIN 1
+#define ISLAND_BATCH_SIZE 16
+#define NO_ISLAND ((u32)-1)
+// how much further than the first hit (as a fraction of the sweep) the tile
+// walk goes, rounding can put a tile it would tie with a little past it
+#define TILE_SWEEP_SLACK 1e-4f
+
+static void solver_list_resize(u32 count) {
+  while (dynlist_size(solver_list) > count) {
+    solver_t solver = dynlist_pop(solver_list);
+    dynlist_destroy(solver.candidate_list);
+    dynlist_destroy(solver.static_list);
+    dynlist_destroy(solver.hit_list);
+    dynlist_destroy(solver.link_list);
+    dynlist_destroy(solver.escaped_list);
+  }
+  while (dynlist_size(solver_list) < count) {
+    *dynlist_append(solver_list) = (solver_t){
+        .candidate_list = dynlist_create(u32, 64),
+        .static_list = dynlist_create(u32, 64),
+        .hit_list = dynlist_create(deferred_hit_t),
+        .link_list = dynlist_create(u32),
+        .escaped_list = dynlist_create(u32),
+    };
+  }
+}
 
-void physics_init(void) {
+void physics_init(broad_phase_t body_broad_phase) {
   body_list = dynlist_create(body_t);
+  body_generations = dynlist_create(u32);
+  body_free_list = dynlist_create(u32);
   static_body_list = dynlist_create(static_body_t);
+  tilemap_list = dynlist_create(tilemap_t);
+  tile_list = dynlist_create(u8);
+  body_callbacks = dynlist_create(body_callbacks_t);
+  snapshot_ring = dynlist_create(snapshot_t);
+  snapshot_next_id = 0;
+  body_fat_aabbs = dynlist_create(aabb_t);
+  body_asleep = dynlist_create(bool);
+  static_changes = dynlist_create(aabb_t);
+  query_list = dynlist_create(u32, 64);
+  contact_table = dynlist_create(contact_t);
+  contact_scratch = dynlist_create(contact_t);
+  body_touching = dynlist_create(touching_t);
+  contact_count = 0;
+  contact_removed = 0;
+  contact_tick = 0;
+  event_list = dynlist_create(collision_event_t);
+  broad_phase = body_broad_phase;
+  grid_init(&body_grid);
+  sap_init(&body_sap);
+  body_brute_ids = dynlist_create(u32);
+  bvh_init(&static_bvh);
+  is_static_bvh_dirty = true;
+  aabb_soa_init(&body_soa);
+  aabb_soa_init(&static_soa);
+
+  solver_list = dynlist_create(solver_t);
+  solver_list_resize(1);
+  island_list = dynlist_create(island_t);
+  island_bodies = dynlist_create(u32);
+  body_island = dynlist_create(u32);
+  island_parent = dynlist_create(u32);
+  thread_count = 1;
 
   terminal_velocity = -7000;
   tick_rate = 1.0f / iterations;
+  fixed_delta = 0;
+  cell_size = DEFAULT_CELL_SIZE;
+  sleep_ticks = DEFAULT_SLEEP_TICKS;
+  sleep_threshold = DEFAULT_SLEEP_THRESHOLD;
+  world_bounds = (bounds_t){{-INFINITY, -INFINITY}, {INFINITY, INFINITY}};
+  layer_bounds_mask = 0;
   LOG("Physics system initialized");
 }
 
 void physics_destroy(void) {
+  grid_destroy(&body_grid);
+  sap_destroy(&body_sap);
+  dynlist_destroy(body_brute_ids);
+  bvh_destroy(&static_bvh);
+  aabb_soa_destroy(&body_soa);
+  aabb_soa_destroy(&static_soa);
+  if (thread_count > 1) {
+    jobs_destroy();
+  }
+  solver_list_resize(0);
+  dynlist_destroy(solver_list);
+  dynlist_destroy(island_list);
+  dynlist_destroy(island_bodies);
+  dynlist_destroy(body_island);
+  dynlist_destroy(island_parent);
+  dynlist_destroy(body_fat_aabbs);
+  dynlist_destroy(body_asleep);
+  dynlist_destroy(static_changes);
+  dynlist_destroy(query_list);
+  dynlist_destroy(contact_table);
+  dynlist_destroy(contact_scratch);
+  dynlist_destroy(body_touching);
+  dynlist_destroy(event_list);
+  physics_snapshot_init(0);
+  dynlist_destroy(snapshot_ring);
+  dynlist_destroy(body_callbacks);
   dynlist_destroy(body_list);
+  dynlist_destroy(body_generations);
+  dynlist_destroy(body_free_list);
   dynlist_destroy(static_body_list);
+  dynlist_destroy(tilemap_list);
+  dynlist_destroy(tile_list);
   LOG("Physics system deinitialized");
 }
 
-void physics_deactivate(size_t idx) {
-  physics_body_get(idx)->is_active = false;
+void physics_deactivate(handle_t handle) {
+  // stale handles are ignored so deactivating twice is harmless
+  if (!physics_body_is_valid(handle)) {
+    return;
+  }
+  u32 idx = handle_index(handle);
+  body_list[idx].is_active = false;
+  body_generations[idx] = handle_next_generation(body_generations[idx]);
+  *dynlist_append(body_free_list) = idx;
 }
 
 f32* physics_get_terminal_velocity(void) { return &terminal_velocity; }
+broad_phase_t physics_get_broad_phase(void) { return broad_phase; }
+f32* physics_get_cell_size(void) { return &cell_size; }
+u32* physics_get_iterations(void) { return &iterations; }
+u32* physics_get_sleep_ticks(void) { return &sleep_ticks; }
+f32* physics_get_sleep_threshold(void) { return &sleep_threshold; }
+physics_stats_t physics_get_stats(void) { return stats; }
+
+void physics_set_thread_count(u32 count) {
+  if (thread_count > 1) {
+    jobs_destroy();
+  }
+  thread_count = 1;
+  if (count != 1) {
+    jobs_init(count);
+    thread_count = jobs_thread_count();
+  }
+  solver_list_resize(thread_count);
+}
 
-static void update_sweep_result(hit_t* result, aabb_t a, aabb_t b,
-                                size_t other_id, vec2 velocity,
-                                u8 a_collision_mask, u8 b_collision_layer) {
-  if ((a_collision_mask & b_collision_layer) == 0) {
+u32 physics_get_thread_count(void) { return thread_count; }
+
+// the bounds covered by an aabb moving by velocity
+static void swept_min_max(vec2 min, vec2 max, aabb_t aabb, vec2 velocity) {
+  aabb_min_max(min, max, aabb);
+  for (u8 i = 0; i < 2; ++i) {
+    if (velocity[i] < 0) {
+      min[i] += velocity[i];
+    } else {
+      max[i] += velocity[i];
+    }
+  }
+}
+
+static void update_static_bvh(void) {
+  if (!is_static_bvh_dirty) {
     return;
   }
 
-  aabb_t sum_aabb = b;
-  vec2_add(sum_aabb.half_size, sum_aabb.half_size, a.half_size);
+  // the static list is append only, so a matching count means the same
+  // bodies were moved or resized and the tree only needs new bounds
+  size_t count = dynlist_size(static_body_list);
+  size_t old_count = dynlist_size(static_bvh.indices);
+  bool is_same_set = count == old_count;
+  if (!is_same_set) {
+    bvh_build_begin(&static_bvh, count);
+  }
+  aabb_soa_resize(&static_soa, count);
+  for (u32 i = 0; i < count; ++i) {
+    static_body_t* static_body = &static_body_list[i];
+    vec2 min, max;
+    aabb_min_max(min, max, static_body->aabb);
+    bvh_set(&static_bvh, i, min, max);
+
+    // the soa still holds the bounds from the last rebuild, anything resting
+    // on or against a static that moved has to be woken
+    bool is_changed = true;
+    if (i < old_count) {
+      aabb_t old = {
+          .position = {static_soa.x[i], static_soa.y[i]},
+          .half_size = {static_soa.hx[i], static_soa.hy[i]},
+      };
+      aabb_t* now = &static_body->aabb;
+      is_changed = !float_eq(old.position[0], now->position[0]) ||
+                   !float_eq(old.position[1], now->position[1]) ||
+                   !float_eq(old.half_size[0], now->half_size[0]) ||
+                   !float_eq(old.half_size[1], now->half_size[1]);
+      vec2 old_min, old_max;
+      aabb_min_max(old_min, old_max, old);
+      for (u8 axis = 0; axis < 2; ++axis) {
+        min[axis] = fminf(min[axis], old_min[axis]);
+        max[axis] = fmaxf(max[axis], old_max[axis]);
+      }
+    }
+    if (is_changed) {
+      *dynlist_append(static_changes) = (aabb_t){
+          .position = {(min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f},
+          .half_size = {(max[0] - min[0]) * 0.5f + STATIC_WAKE_MARGIN,
+                        (max[1] - min[1]) * 0.5f + STATIC_WAKE_MARGIN},
+      };
+    }
+    aabb_soa_set(&static_soa, i, static_body->aabb.position,
+                 static_body->aabb.half_size, static_body->collision_layer, 0);
+  }
+  if (is_same_set) {
+    bvh_refit(&static_bvh);
+  } else {
+    bvh_build_end(&static_bvh);
+  }
 
-  hit_t hit = ray_intersect_aabb(a.position, velocity, sum_aabb);
-  if (hit.is_hit) {
-    if (hit.time < result->time) {
-      *result = hit;
-    } else if (float_eq(hit.time, result->time)) {
-      // get the highest velocity axis first
-      if (fabsf(velocity[0]) > fabsf(velocity[1]) && hit.normal[0] != 0.0f) {
-        *result = hit;
-      } else if (fabsf(velocity[1]) > fabsf(velocity[0]) &&
-                 hit.normal[1] != 0.0f) {
-        *result = hit;
+  is_static_bvh_dirty = false;
+}
+
+static void wake_body(body_t* body) {
+  body->is_sleeping = false;
+  body->still_ticks = 0;
+}
+
+static void broad_phase_build_begin(size_t count) {
+  switch (broad_phase) {
+    case BROAD_PHASE_GRID:
+      grid_build_begin(&body_grid, count, max(cell_size, 1.0f));
+      break;
+    case BROAD_PHASE_SAP:
+      sap_build_begin(&body_sap, count);
+      break;
+    case BROAD_PHASE_BRUTE:
+      dynlist_clear(body_brute_ids);
+      break;
+  }
+}
+
+static void broad_phase_set(u32 id, vec2 min, vec2 max) {
+  switch (broad_phase) {
+    case BROAD_PHASE_GRID:
+      grid_set(&body_grid, id, min, max);
+      break;
+    case BROAD_PHASE_SAP:
+      sap_set(&body_sap, id, min, max);
+      break;
+    case BROAD_PHASE_BRUTE:
+      *dynlist_append(body_brute_ids) = id;
+      break;
+  }
+}
+
+static void broad_phase_build_end(void) {
+  switch (broad_phase) {
+    case BROAD_PHASE_GRID:
+      grid_build_end(&body_grid);
+      break;
+    case BROAD_PHASE_SAP:
+      sap_build_end(&body_sap);
+      break;
+    case BROAD_PHASE_BRUTE:
+      break;
+  }
+}
+
+// every broad phase appends at least the bodies near [min, max], in ascending
+// id order like the static bvh. the candidates are visited by id however the
+// broad phase was built, so ties resolve the same in deterministic mode.
+static void broad_phase_query(vec2 min, vec2 max, u32** out) {
+  switch (broad_phase) {
+    case BROAD_PHASE_GRID:
+      grid_query(&body_grid, min, max, out);
+      break;
+    case BROAD_PHASE_SAP:
+      sap_query(&body_sap, min, max, out);
+      break;
+    case BROAD_PHASE_BRUTE:
+      // culls nothing, every body is left to the narrow phase so that
+      // pairs_tested shows what the other broad phases save
+      dynlist_each(body_brute_ids, id) { *dynlist_append(*out) = *id; }
+      break;
+  }
+}
+
+static void build_body_broad_phase(f32 delta_time) {
+  // bodies move during the update, so they are inserted with their bounds
+  // over the whole frame (velocity plus one step of acceleration), sleeping
+  // bodies stay where they are
+  broad_phase_build_begin(dynlist_size(body_list));
+  aabb_soa_resize(&body_soa, dynlist_size(body_list));
+  dynlist_resize(body_fat_aabbs, dynlist_size(body_list));
+  dynlist_resize(body_asleep, dynlist_size(body_list));
+  stats.sleeping_count = 0;
+  for (u32 i = 0; i < dynlist_size(body_list); ++i) {
+    body_t* body = &body_list[i];
+    aabb_soa_set(&body_soa, i, body->aabb.position, body->aabb.half_size,
+                 body->collision_layer, body->collision_mask);
+
+    // the game moved or pushed it since it fell asleep
+    if (body->is_sleeping &&
+        (!float_eq(body->velocity[0], 0) || !float_eq(body->velocity[1], 0) ||
+         !float_eq(body->aabb.position[0], body->prev_position[0]) ||
+         !float_eq(body->aabb.position[1], body->prev_position[1]))) {
+      wake_body(body);
+    }
+    body_asleep[i] = body->is_active && body->is_sleeping;
+    if (!body->is_active) {
+      continue;
+    }
+
+    vec2 motion = {0, 0};
+    if (body_asleep[i]) {
+      ++stats.sleeping_count;
+    } else {
+      motion[0] = fabsf(body->velocity[0]) + fabsf(body->acceleration[0]);
+      motion[1] = fabsf(body->velocity[1]) + fabsf(body->acceleration[1]);
+      vec2_scale(motion, motion, delta_time);
+    }
+
+    aabb_t* fat = &body_fat_aabbs[i];
+    *fat = body->aabb;
+    vec2_add(fat->half_size, fat->half_size, motion);
+
+    vec2 min, max;
+    aabb_min_max(min, max, *fat);
+    broad_phase_set(i, min, max);
+  }
+  broad_phase_build_end();
+}
+
+static int cmp_u32(const void* a, const void* b) {
+  u32 x = *(const u32*)a;
+  u32 y = *(const u32*)b;
+  return (x > y) - (x < y);
+}
+
+// the broad phase is the one built by the last update, where every body was
+// inserted with the bounds it could reach. bodies that left those bounds or
+// were created since then are not in it and are checked one by one.
+static void query_bodies(vec2 min, vec2 max) {
+  ASSERT(dynlist_size(body_fat_aabbs) <= dynlist_size(body_list),
+         "the body broad phase holds bodies that no longer exist");
+  dynlist_clear(query_list);
+  broad_phase_query(min, max, &query_list);
+
+  size_t escaped_count = 0;
+  for (size_t s = 0; s < dynlist_size(solver_list); ++s) {
+    solver_t* solver = &solver_list[s];
+    for (size_t i = 0; i < dynlist_size(solver->escaped_list); ++i) {
+      *dynlist_append(query_list) = solver->escaped_list[i];
+    }
+    escaped_count += dynlist_size(solver->escaped_list);
+  }
+  if (escaped_count > 0) {
+    size_t count = dynlist_size(query_list);
+    qsort(query_list, count, sizeof(u32), cmp_u32);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (unique == 0 || query_list[unique - 1] != query_list[i]) {
+        query_list[unique++] = query_list[i];
       }
     }
-    result->other_id = other_id;
+    dynlist_resize_no_contract(query_list, unique);
+  }
+
+  for (u32 i = dynlist_size(body_fat_aabbs); i < dynlist_size(body_list);
+       ++i) {
+    *dynlist_append(query_list) = i;
   }
 }
 
-static hit_t sweep_static_bodies(body_t* body, vec2 velocity) {
-  hit_t result = {.time = 0xBBBB};
+// the broad phase still holds the bodies from the last update, which is where
+// the sleeping ones still are. after a restore it is empty and query_bodies
+// checks them one by one.
+static void wake_near_static_changes(void) {
+  for (size_t i = 0; i < dynlist_size(static_changes); ++i) {
+    aabb_t* region = &static_changes[i];
+    vec2 min, max;
+    aabb_min_max(min, max, *region);
+    query_bodies(min, max);
+    dynlist_each(query_list, id) {
+      body_t* body = &body_list[*id];
+      if (body->is_sleeping &&
+          physics_aabb_intersect_aabb(*region, body->aabb)) {
+        wake_body(body);
+      }
+    }
+  }
+  dynlist_clear(static_changes);
+}
+
+static void sync_body_soa(body_t* body) {
+  aabb_soa_set(&body_soa, body - body_list, body->aabb.position,
+               body->aabb.half_size, body->collision_layer,
+               body->collision_mask);
+}
 
-  for (u32 i = 0; i < dynlist_size(static_body_list); ++i) {
-    static_body_t* static_body = physics_static_body_get(i);
-    update_sweep_result(&result, body->aabb, static_body->aabb, i, velocity,
-                        body->collision_mask, static_body->collision_layer);
+static bool is_earlier_hit(hit_t hit, hit_t result, vec2 velocity) {
+  if (hit.time < result.time) {
+    return true;
+  }
+  if (!float_eq(hit.time, result.time)) {
+    return false;
   }
+  // get the highest velocity axis first
+  return (fabsf(velocity[0]) > fabsf(velocity[1]) &&
+          fabsf(hit.normal[0]) > 0.0f) ||
+         (fabsf(velocity[1]) > fabsf(velocity[0]) &&
+          fabsf(hit.normal[1]) > 0.0f);
+}
 
-  return result;
+static void update_sweep_result(hit_t* result, hit_t hit, vec2 velocity) {
+  if (is_earlier_hit(hit, *result, velocity)) {
+    *result = hit;
+  }
 }
 
-static hit_t sweep_bodies(body_t* body, vec2 velocity) {
+// runs the batched test over the packed candidates, then the full scalar
+// intersection only for the lanes that were hit to get the hit details
+static void flush_sweep_batch(hit_t* result, sweep_batch_t* batch,
+                              body_t* body, vec2 velocity) {
+  u32 is_hit[SWEEP_BATCH_WIDTH];
+  sweep_batch_test(batch, body->aabb.position, body->aabb.half_size, velocity,
+                   is_hit);
+
+  for (u32 lane = 0; lane < batch->count; ++lane) {
+    if (!is_hit[lane]) {
+      continue;
+    }
+    aabb_t sum_aabb = {
+        .position = {batch->x[lane], batch->y[lane]},
+        .half_size = {batch->hx[lane], batch->hy[lane]},
+    };
+    vec2_add(sum_aabb.half_size, sum_aabb.half_size, body->aabb.half_size);
+
+    hit_t hit = ray_intersect_aabb(body->aabb.position, velocity, sum_aabb);
+    if (hit.is_hit) {
+      hit.other_id = batch->id[lane];
+      update_sweep_result(result, hit, velocity);
+    }
+  }
+  batch->count = 0;
+}
+
+// narrow phase over the candidates against the boxes in soa, only the solid
+// bodies when is_solid_only is set (body candidates only)
+static hit_t sweep_candidates(solver_t* solver, const u32* candidates,
+                              body_t* body, vec2 velocity, aabb_soa_t* soa,
+                              size_t skip_id, bool is_solid_only) {
   hit_t result = {.time = 0xBBBB};
+  sweep_batch_t batch = {0};
 
-  for (u32 i = 0; i < dynlist_size(body_list); ++i) {
-    body_t* other = physics_body_get(i);
-    if (body == other) {
+  dynlist_each(candidates, id) {
+    ++solver->pairs_tested;
+    if (*id == skip_id || (body->collision_mask & soa->layer[*id]) == 0 ||
+        (is_solid_only && !body_list[*id].is_solid)) {
       continue;
     }
-    update_sweep_result(&result, body->aabb, other->aabb, i, velocity,
-                        body->collision_mask, other->collision_layer);
+    sweep_batch_push(&batch, soa, *id);
+    if (batch.count == SWEEP_BATCH_WIDTH) {
+      flush_sweep_batch(&result, &batch, body, velocity);
+    }
   }
+  flush_sweep_batch(&result, &batch, body, velocity);
 
   return result;
 }
 
-static void sweep_response(body_t* body, vec2 velocity) {
-  hit_t hit_static_body = sweep_static_bodies(body, velocity);
-  hit_t hit_body = sweep_bodies(body, velocity);
+static aabb_t tile_aabb(const tilemap_t* map, u32 x, u32 y) {
+  return (aabb_t){
+      .position = {map->origin[0] + (x + 0.5f) * map->tile_size[0],
+                   map->origin[1] + (y + 0.5f) * map->tile_size[1]},
+      .half_size = {map->tile_size[0] * 0.5f, map->tile_size[1] * 0.5f},
+  };
+}
 
-  if (hit_body.is_hit) {
-    if (body->on_hit != NULL) {
-      body->on_hit(body, physics_body_get(hit_body.other_id), hit_body);
+static u8 tile_layer(const tilemap_t* map, u32 x, u32 y) {
+  return map->layers[tile_list[map->first + y * map->width + x]];
+}
+
+// the map holding a tile id
+static tilemap_t* tile_map(size_t tile) {
+  dynlist_each(tilemap_list, map) {
+    if (tile - map->first < (size_t)map->width * map->height) {
+      return map;
+    }
+  }
+  ASSERT(false, "tile %zu is in no tilemap", tile);
+  return NULL;
+}
+
+// the tiles from x0 to x1 and y0 to y1 (in tile units, as floats so they can
+// lie off the map and far from it without overflowing) that are on the map
+static void sweep_tile_range(solver_t* solver, const tilemap_t* map,
+                             body_t* body, vec2 velocity, f32 x0, f32 x1,
+                             f32 y0, f32 y1, hit_t* result, bool* is_tile) {
+  x0 = fmaxf(x0, 0);
+  y0 = fmaxf(y0, 0);
+  x1 = fminf(x1, map->width - 1.0f);
+  y1 = fminf(y1, map->height - 1.0f);
+  for (f32 y = y0; y <= y1; ++y) {
+    for (f32 x = x0; x <= x1; ++x) {
+      ++solver->pairs_tested;
+      if ((body->collision_mask & tile_layer(map, x, y)) == 0) {
+        continue;
+      }
+      aabb_t sum_aabb = tile_aabb(map, x, y);
+      vec2_add(sum_aabb.half_size, sum_aabb.half_size, body->aabb.half_size);
+
+      hit_t hit = ray_intersect_aabb(body->aabb.position, velocity, sum_aabb);
+      if (hit.is_hit && is_earlier_hit(hit, *result, velocity)) {
+        hit.other_id = map->first + (u32)y * map->width + (u32)x;
+        *result = hit;
+        *is_tile = true;
+      }
+    }
+  }
+}
+
+// walks the tiles the body passes through in the order it reaches them,
+// starting with the ones it already overlaps. every step enters the next
+// column or row on one axis, tested against the tiles the body covers on the
+// other axis at that time, until the step is further than the first hit.
+static void sweep_tilemap(solver_t* solver, const tilemap_t* map, body_t* body,
+                          vec2 velocity, hit_t* result, bool* is_tile) {
+  // the body's bounds and motion in tile units
+  vec2 min, max, lo, hi, step;
+  aabb_min_max(min, max, body->aabb);
+  for (u8 i = 0; i < 2; ++i) {
+    lo[i] = (min[i] - map->origin[i]) / map->tile_size[i];
+    hi[i] = (max[i] - map->origin[i]) / map->tile_size[i];
+    step[i] = velocity[i] / map->tile_size[i];
+  }
+  if (fmaxf(hi[0], hi[0] + step[0]) <= 0 ||
+      fmaxf(hi[1], hi[1] + step[1]) <= 0 ||
+      fminf(lo[0], lo[0] + step[0]) >= map->width ||
+      fminf(lo[1], lo[1] + step[1]) >= map->height) {
+    return;
+  }
+
+  // the tiles the body overlaps, only touching one does not count
+  vec2 first = {floorf(lo[0]), floorf(lo[1])};
+  vec2 last = {ceilf(hi[0]) - 1, ceilf(hi[1]) - 1};
+  sweep_tile_range(solver, map, body, velocity, first[0], last[0], first[1],
+                   last[1], result, is_tile);
+
+  vec2 next;
+  for (u8 i = 0; i < 2; ++i) {
+    next[i] = step[i] > 0   ? (last[i] + 1 - hi[i]) / step[i]
+              : step[i] < 0 ? (first[i] - lo[i]) / step[i]
+                            : INFINITY;
+  }
+  for (;;) {
+    u8 axis = next[0] <= next[1] ? 0 : 1;
+    u8 other = !axis;
+    f32 t = next[axis];
+    if (t > 1 || t > result->time + TILE_SWEEP_SLACK) {
+      break;
+    }
+
+    f32 line = step[axis] > 0 ? ++last[axis] : --first[axis];
+    f32 from = first[other];
+    f32 to = last[other];
+    if (step[other] > 0) {
+      from = fmaxf(from, floorf(lo[other] + step[other] * t));
+    } else if (step[other] < 0) {
+      to = fminf(to, ceilf(hi[other] + step[other] * t) - 1);
+    }
+    if (axis == 0) {
+      sweep_tile_range(solver, map, body, velocity, line, line, from, to,
+                       result, is_tile);
+    } else {
+      sweep_tile_range(solver, map, body, velocity, from, to, line, line,
+                       result, is_tile);
+    }
+
+    next[axis] = step[axis] > 0 ? (last[axis] + 1 - hi[axis]) / step[axis]
+                                : (first[axis] - lo[axis]) / step[axis];
+  }
+}
+
+// the first static body or tile in the way, kind tells which
+static hit_t sweep_static_bodies(solver_t* solver, body_t* body,
+                                 vec2 velocity, collision_kind_t* kind) {
+  dynlist_clear(solver->static_list);
+  bvh_query_ray(&static_bvh, body->aabb.position, velocity,
+                body->aabb.half_size, &solver->static_list);
+  solver->is_on_static_sweep = true;
+
+  hit_t result = sweep_candidates(solver, solver->static_list, body, velocity,
+                                  &static_soa, (size_t)-1, false);
+  bool is_tile = false;
+  dynlist_each(tilemap_list, map) {
+    sweep_tilemap(solver, map, body, velocity, &result, &is_tile);
+  }
+  *kind = is_tile ? COLLISION_TILE : COLLISION_STATIC;
+  return result;
+}
+
+// the first body in the way, and in solid_hit the first solid one when the
+// body is solid itself. both come from the same candidates.
+static hit_t sweep_bodies(solver_t* solver, body_t* body, vec2 velocity,
+                          hit_t* solid_hit) {
+  vec2 min, max;
+  swept_min_max(min, max, body->aabb, velocity);
+  dynlist_clear(solver->candidate_list);
+  broad_phase_query(min, max, &solver->candidate_list);
+
+  // other islands are being moved by other workers at the same time, they
+  // could not be reached anyway
+  if (solver->is_parallel) {
+    size_t count = 0;
+    dynlist_each(solver->candidate_list, id) {
+      if (body_island[*id] == solver->island) {
+        solver->candidate_list[count++] = *id;
+      }
+    }
+    dynlist_resize_no_contract(solver->candidate_list, count);
+  }
+
+  hit_t hit = sweep_candidates(solver, solver->candidate_list, body, velocity,
+                               &body_soa, body - body_list, false);
+  *solid_hit = (hit_t){0};
+  if (body->is_solid && !body->is_kinematic) {
+    *solid_hit = hit.is_hit && body_list[hit.other_id].is_solid
+                     ? hit
+                     : sweep_candidates(solver, solver->candidate_list, body,
+                                        velocity, &body_soa, body - body_list,
+                                        true);
+  }
+  return hit;
+}
+
+// hits are queued while solving, callbacks only run from dispatch_hits once
+// every body has moved so they never change a body in the middle of the solve
+static void report_hit(solver_t* solver, body_t* body, hit_t hit,
+                       collision_kind_t kind) {
+  *dynlist_append(solver->hit_list) = (deferred_hit_t){
+      .self = body - body_list,
+      .other = hit.other_id,
+      .hit = hit,
+      .kind = kind,
+  };
+}
+
+// bodies that already overlapped a sleeper (time below 0) leave it be,
+// otherwise two resting bodies would keep waking each other up. the same goes
+// for a solid body coming to rest on a sleeper it can not push.
+static void body_hit_response(solver_t* solver, body_t* body, hit_t hit,
+                              bool can_wake) {
+  body_t* other = &body_list[hit.other_id];
+  if (other->is_sleeping && hit.time >= 0 && can_wake) {
+    wake_body(other);
+  }
+  report_hit(solver, body, hit, COLLISION_BODY);
+}
+
+static u8 contact_directions(f32 x, f32 y) {
+  return (y > 0 ? CONTACT_UP : 0) | (y < 0 ? CONTACT_DOWN : 0) |
+         (x < 0 ? CONTACT_LEFT : 0) | (x > 0 ? CONTACT_RIGHT : 0);
+}
+
+// whether the body rested against something on the side it would be pushed
+// toward during the last update, it then holds like a kinematic body would
+static bool is_braced(u32 id, vec2 normal) {
+  if (id >= dynlist_size(body_touching) ||
+      body_touching[id].generation != body_generations[id]) {
+    return false;
+  }
+  touching_t* touching = &body_touching[id];
+  u8 side = contact_directions(normal[0], normal[1]);
+  for (u32 bits = touching->layers; bits != 0; bits &= bits - 1) {
+    if (touching->directions[__builtin_ctz(bits)] & side) {
+      return true;
     }
   }
+  return false;
+}
+
+// whether the body meets a solid body before any static body, in time of
+// impact order the static body is then never reached. the sweep is against
+// where the other body is now, whether or not it has moved this update.
+static bool stops_at_solid(hit_t hit_solid, hit_t hit_static_body) {
+  return hit_solid.is_hit && hit_solid.time >= 0 &&
+         (!hit_static_body.is_hit || hit_solid.time < hit_static_body.time);
+}
+
+// bodies closing in on each other share their speed, a body catching up
+// with one moving away only stops behind it
+static bool is_pushing(body_t* body, hit_t hit) {
+  body_t* other = &body_list[hit.other_id];
+  u32 axis = fabsf(hit.normal[0]) > fabsf(hit.normal[1]) ? 0 : 1;
+  return (body->velocity[axis] - other->velocity[axis]) * hit.normal[axis] <
+             0 &&
+         !other->is_kinematic && !is_braced(hit.other_id, hit.normal);
+}
+
+// the rest of a solid body's motion along a contact on axis, stopped by the
+// first static or solid body in the way so it can not pass through either.
+// nothing is pushed, so a sleeper in the way is left asleep.
+static void slide_body(solver_t* solver, body_t* body, vec2 slide, u32 axis) {
+  collision_kind_t kind;
+  hit_t hit_static_body = sweep_static_bodies(solver, body, slide, &kind);
+  hit_t hit_solid;
+  sweep_bodies(solver, body, slide, &hit_solid);
+
+  if (stops_at_solid(hit_solid, hit_static_body)) {
+    body->aabb.position[0] = hit_solid.position[0];
+    body->aabb.position[1] = hit_solid.position[1];
+    f32 other_velocity = body_list[hit_solid.other_id].velocity[!axis];
+    if ((body->velocity[!axis] - other_velocity) * hit_solid.normal[!axis] <
+        0) {
+      body->velocity[!axis] = other_velocity;
+    }
+    body_hit_response(solver, body, hit_solid, false);
+  } else if (hit_static_body.is_hit) {
+    body->aabb.position[0] = hit_static_body.position[0];
+    body->aabb.position[1] = hit_static_body.position[1];
+    body->velocity[!axis] = 0.0f;
+    report_hit(solver, body, hit_static_body, kind);
+  } else {
+    vec2_add(body->aabb.position, body->aabb.position, slide);
+  }
+}
+
+// stops the body where it meets the solid body. a push leaves both with their
+// average speed along the normal, otherwise the body takes the other's speed
+// if it was closing in on it. the rest of the motion slides along the
+// contact.
+static void solid_response(solver_t* solver, body_t* body, vec2 velocity,
+                           hit_t hit, bool is_push) {
+  body_t* other = &body_list[hit.other_id];
+  u32 axis = fabsf(hit.normal[0]) > fabsf(hit.normal[1]) ? 0 : 1;
+  if (is_push) {
+    f32 shared = (body->velocity[axis] + other->velocity[axis]) * 0.5f;
+    body->velocity[axis] = shared;
+    other->velocity[axis] = shared;
+  } else if ((body->velocity[axis] - other->velocity[axis]) *
+                 hit.normal[axis] <
+             0) {
+    body->velocity[axis] = other->velocity[axis];
+  }
+
+  body->aabb.position[0] = hit.position[0];
+  body->aabb.position[1] = hit.position[1];
+
+  vec2 slide = {0, 0};
+  slide[!axis] = velocity[!axis] * (1.0f - hit.time);
+  slide_body(solver, body, slide, axis);
+}
+
+static void sweep_response(solver_t* solver, body_t* body, vec2 velocity) {
+  collision_kind_t kind;
+  hit_t hit_static_body = sweep_static_bodies(solver, body, velocity, &kind);
+  hit_t hit_solid;
+  hit_t hit_body = sweep_bodies(solver, body, velocity, &hit_solid);
+
+  bool is_stopped = stops_at_solid(hit_solid, hit_static_body);
+  bool is_push = is_stopped && is_pushing(body, hit_solid);
+  if (hit_body.is_hit) {
+    body_hit_response(solver, body, hit_body,
+                      !is_stopped || is_push ||
+                          hit_body.other_id != hit_solid.other_id);
+  }
+  if (hit_solid.is_hit && hit_solid.other_id != hit_body.other_id) {
+    body_hit_response(solver, body, hit_solid, !is_stopped || is_push);
+  }
+
+  if (is_stopped) {
+    solid_response(solver, body, velocity, hit_solid, is_push);
+    return;
+  }
 
   if (hit_static_body.is_hit) {
     // move the body to the point of collision based on the hit time.
@@ -106,20 +956,29 @@ static void sweep_response(body_t* body, vec2 velocity) {
 
     // after moving, stop the body's velocity in the direction of the collision.
     // this prevents it from trying to move further into the wall.
+    vec2 slide = {0, 0};
     if (hit_static_body.normal[0] != 0.0f) {
-      body->aabb.position[1] += velocity[1];
+      slide[1] = velocity[1];
       body->velocity[0] = 0.0f;
     }
     if (hit_static_body.normal[1] != 0.0f) {
-      body->aabb.position[0] += velocity[0];
+      slide[0] = velocity[0];
       body->velocity[1] = 0.0f;
     }
 
     // kinematic and normal bodies should both still report static collision
-    if (body->on_hit_static != NULL) {
-      body->on_hit_static(body,
-                          physics_static_body_get(hit_static_body.other_id),
-                          hit_static_body);
+    report_hit(solver, body, hit_static_body, kind);
+
+    // solid bodies can not slide into each other either
+    if (body->is_solid && !body->is_kinematic) {
+      u32 axis =
+          fabsf(hit_static_body.normal[0]) > fabsf(hit_static_body.normal[1])
+              ? 0
+              : 1;
+      slide_body(solver, body, slide, axis);
+    } else {
+      vec2_add(body->aabb.position, body->aabb.position, slide);
+      solver->is_on_static_sweep = false;
     }
   } else {
     // no collision was found, continue to move the body in its direction
@@ -127,57 +986,669 @@ static void sweep_response(body_t* body, vec2 velocity) {
   }
 }
 
-static void stationary_response(body_t* body) {
-  dynlist_each(static_body_list, static_body) {
-    if ((body->collision_mask & static_body->collision_layer) == 0) {
+static bool is_tile_solid(const tilemap_t* map, f32 x, f32 y, u8 mask) {
+  return x >= 0 && y >= 0 && x < map->width && y < map->height &&
+         (tile_layer(map, x, y) & mask) != 0;
+}
+
+// the shortest way out of a tile that does not lead into a solid neighbour,
+// so a body sunk into a floor is pushed up and not sideways where two of its
+// tiles meet
+static void tile_penetration_vector(vec2 r, const tilemap_t* map, f32 x,
+                                    f32 y, u8 mask, aabb_t mink_aabb) {
+  vec2 min, max;
+  aabb_min_max(min, max, mink_aabb);
+
+  // sides in the order aabb_penetration_vector tries them
+  f32 pushes[4] = {min[0], max[0], min[1], max[1]};
+  bool is_open[4] = {
+      !is_tile_solid(map, x - 1, y, mask),
+      !is_tile_solid(map, x + 1, y, mask),
+      !is_tile_solid(map, x, y - 1, mask),
+      !is_tile_solid(map, x, y + 1, mask),
+  };
+  f32 min_dist = INFINITY;
+  for (u8 i = 0; i < 4; ++i) {
+    if (is_open[i] && fabsf(pushes[i]) < min_dist) {
+      min_dist = fabsf(pushes[i]);
+      r[i / 2] = pushes[i];
+      r[!(i / 2)] = 0;
+    }
+  }
+
+  // walled in on every side, any way out is better than none
+  if (isinf(min_dist)) {
+    aabb_penetration_vector(r, mink_aabb);
+  }
+}
+
+// pushes the body out of the statics in the batch that it overlaps, one at a
+// time in lane order. the overlaps and pushes are found for the whole batch at
+// once, and again for the lanes after a push from where it moved the body.
+static void depenetrate_batch(body_t* body, sweep_batch_t* batch) {
+  u32 is_hit[SWEEP_BATCH_WIDTH];
+  f32 push_x[SWEEP_BATCH_WIDTH], push_y[SWEEP_BATCH_WIDTH];
+  sweep_batch_penetration(batch, body->aabb.position, body->aabb.half_size,
+                          is_hit, push_x, push_y);
+
+  for (u32 lane = 0; lane < batch->count; ++lane) {
+    if (!is_hit[lane]) {
+      continue;
+    }
+    body->aabb.position[0] += push_x[lane];
+    body->aabb.position[1] += push_y[lane];
+    if (lane + 1 < batch->count) {
+      sweep_batch_penetration(batch, body->aabb.position,
+                              body->aabb.half_size, is_hit, push_x, push_y);
+    }
+  }
+  batch->count = 0;
+}
+
+static void stationary_response(solver_t* solver, body_t* body) {
+  // the static sweep already gathered every static along the body's path, so
+  // unless the body left it those are reused rather than queried again
+  vec2 min, max;
+  aabb_min_max(min, max, body->aabb);
+  if (!solver->is_on_static_sweep) {
+    dynlist_clear(solver->static_list);
+    bvh_query(&static_bvh, min, max, &solver->static_list);
+  }
+
+  // the static bodies should repel any overlapping bodies
+  sweep_batch_t batch = {0};
+  dynlist_each(solver->static_list, id) {
+    ++solver->pairs_tested;
+    if ((body->collision_mask & static_soa.layer[*id]) == 0) {
       continue;
     }
-    // the static bodies should repel any overlapping bodies
-    if (physics_aabb_intersect_aabb(static_body->aabb, body->aabb)) {
-      vec2 penetration_vector;
-      aabb_t diff = aabb_minkowski_difference(static_body->aabb, body->aabb);
-      aabb_penetration_vector(penetration_vector, diff);
+    sweep_batch_push(&batch, &static_soa, *id);
+    if (batch.count == SWEEP_BATCH_WIDTH) {
+      depenetrate_batch(body, &batch);
+    }
+  }
+  depenetrate_batch(body, &batch);
+
+  // tiles repel it the same way, the ones it overlapped before it was pushed
+  // one at a time
+  dynlist_each(tilemap_list, map) {
+    f32 x0 = fmaxf(floorf((min[0] - map->origin[0]) / map->tile_size[0]), 0);
+    f32 y0 = fmaxf(floorf((min[1] - map->origin[1]) / map->tile_size[1]), 0);
+    f32 x1 = fminf(ceilf((max[0] - map->origin[0]) / map->tile_size[0]) - 1,
+                   map->width - 1.0f);
+    f32 y1 = fminf(ceilf((max[1] - map->origin[1]) / map->tile_size[1]) - 1,
+                   map->height - 1.0f);
+    for (f32 y = y0; y <= y1; ++y) {
+      for (f32 x = x0; x <= x1; ++x) {
+        ++solver->pairs_tested;
+        if ((body->collision_mask & tile_layer(map, x, y)) == 0) {
+          continue;
+        }
+        aabb_t tile = tile_aabb(map, x, y);
+        if (physics_aabb_intersect_aabb(tile, body->aabb)) {
+          vec2 penetration_vector;
+          aabb_t diff = aabb_minkowski_difference(tile, body->aabb);
+          tile_penetration_vector(penetration_vector, map, x, y,
+                                  body->collision_mask, diff);
+          vec2_add(body->aabb.position, body->aabb.position,
+                   penetration_vector);
+        }
+      }
+    }
+  }
+}
 
-      // move the position by the penetration_vector
-      vec2_add(body->aabb.position, body->aabb.position, penetration_vector);
+// a body that barely moved for sleep_ticks ticks in a row is put to sleep
+static void update_sleep(body_t* body, f32 delta_time) {
+  if (sleep_ticks == 0 || body->is_always_awake) {
+    body->still_ticks = 0;
+    return;
+  }
+
+  vec2 moved;
+  vec2_sub(moved, body->aabb.position, body->prev_position);
+  f32 max_moved = sleep_threshold * delta_time;
+  f32 moved_sq = moved[0] * moved[0] + moved[1] * moved[1];
+  f32 speed_sq = body->velocity[0] * body->velocity[0] +
+                 body->velocity[1] * body->velocity[1];
+  if (moved_sq > max_moved * max_moved ||
+      speed_sq > sleep_threshold * sleep_threshold) {
+    body->still_ticks = 0;
+    return;
+  }
+
+  if (++body->still_ticks >= sleep_ticks) {
+    body->is_sleeping = true;
+    body->velocity[0] = 0;
+    body->velocity[1] = 0;
+  }
+}
+
+static void solve_body(solver_t* solver, body_t* body, f32 delta_time) {
+  body->prev_position[0] = body->aabb.position[0];
+  body->prev_position[1] = body->aabb.position[1];
+  if (!body->is_active || body_asleep[body - body_list]) {
+    return;
+  }
+
+  // kinematic bodies are normal bodies but do not follow gravity
+  if (!body->is_kinematic) {
+    body->velocity[0] += body->acceleration[0];
+    body->velocity[1] += body->acceleration[1];
+    if (terminal_velocity > body->velocity[1]) {
+      body->velocity[1] = terminal_velocity;
     }
   }
+
+  // the broad phases narrow each sweep down to the nearby candidates
+  for (u32 i = 0; i < iterations; ++i) {
+    vec2 scaled_velocity;
+    vec2_scale(scaled_velocity, body->velocity, delta_time * tick_rate);
+
+    sweep_response(solver, body, scaled_velocity);
+    stationary_response(solver, body);
+    solver->clamp_count += physics_clamp_body(body);
+    sync_body_soa(body);
+  }
+
+  // pushed out of a static or clamped further than its velocity reaches, the
+  // broad phase no longer covers it so the queries have to check it on its
+  // own
+  u32 idx = body - body_list;
+  vec2 min, max, fat_min, fat_max;
+  aabb_min_max(min, max, body->aabb);
+  aabb_min_max(fat_min, fat_max, body_fat_aabbs[idx]);
+  if (min[0] < fat_min[0] || min[1] < fat_min[1] || max[0] > fat_max[0] ||
+      max[1] > fat_max[1]) {
+    *dynlist_append(solver->escaped_list) = idx;
+  }
+
+  update_sleep(body, delta_time);
+}
+
+// bodies interact when either one's mask has the other's layer and the space
+// they can cover this update overlaps
+static bool can_interact(u32 a, u32 b) {
+  body_t* body_a = &body_list[a];
+  body_t* body_b = &body_list[b];
+  if ((body_a->collision_mask & body_b->collision_layer) == 0 &&
+      (body_b->collision_mask & body_a->collision_layer) == 0) {
+    return false;
+  }
+  return physics_aabb_intersect_aabb(body_fat_aabbs[a], body_fat_aabbs[b]);
 }
 
-void physics_update(f32 delta_time) {
-  dynlist_each(body_list, body) {
-    if (!body->is_active) {
+static void find_island_links(void* data, u32 begin, u32 end, u32 worker) {
+  (void)data;
+  solver_t* solver = &solver_list[worker];
+  for (u32 i = begin; i < end; ++i) {
+    if (!body_list[i].is_active || body_asleep[i]) {
+      continue;
+    }
+    vec2 min, max;
+    aabb_min_max(min, max, body_fat_aabbs[i]);
+    dynlist_clear(solver->candidate_list);
+    broad_phase_query(min, max, &solver->candidate_list);
+    // each pair is linked once, by its lower id or by the awake side.
+    // sleepers do not move, two of them never have to share an island
+    dynlist_each(solver->candidate_list, id) {
+      if ((*id > i || body_asleep[*id]) && can_interact(i, *id)) {
+        *dynlist_append(solver->link_list) = i;
+        *dynlist_append(solver->link_list) = *id;
+      }
+    }
+  }
+}
+
+static u32 island_find(u32 id) {
+  while (island_parent[id] != id) {
+    island_parent[id] = island_parent[island_parent[id]];
+    id = island_parent[id];
+  }
+  return id;
+}
+
+static void build_islands(void) {
+  u32 body_count = dynlist_size(body_list);
+  dynlist_each(solver_list, solver) { dynlist_clear(solver->link_list); }
+  jobs_parallel_for(find_island_links, NULL, body_count, 256);
+
+  dynlist_resize(island_parent, body_count);
+  for (u32 i = 0; i < body_count; ++i) {
+    island_parent[i] = i;
+  }
+  dynlist_each(solver_list, solver) {
+    for (size_t i = 0; i < dynlist_size(solver->link_list); i += 2) {
+      u32 a = island_find(solver->link_list[i]);
+      u32 b = island_find(solver->link_list[i + 1]);
+      // the lowest id stays the root so numbering does not depend on the
+      // order the workers found the links in
+      island_parent[max(a, b)] = min(a, b);
+    }
+  }
+
+  // islands are numbered by their lowest body, roots always come first
+  dynlist_resize(body_island, body_count);
+  dynlist_clear(island_list);
+  for (u32 i = 0; i < body_count; ++i) {
+    if (!body_list[i].is_active) {
+      body_island[i] = NO_ISLAND;
       continue;
     }
+    u32 root = island_find(i);
+    if (root == i) {
+      body_island[i] = dynlist_size(island_list);
+      *dynlist_append(island_list) = (island_t){0};
+    } else {
+      body_island[i] = body_island[root];
+    }
+    ++island_list[body_island[i]].count;
+    island_list[body_island[i]].has_awake |= !body_asleep[i];
+  }
+
+  // drop the islands with nothing to solve, first holds the new numbers until
+  // the ranges are laid out below
+  u32 kept = 0;
+  dynlist_each(island_list, island) {
+    island->first = island->has_awake ? kept++ : NO_ISLAND;
+  }
+  for (u32 i = 0; i < body_count; ++i) {
+    if (body_island[i] != NO_ISLAND) {
+      body_island[i] = island_list[body_island[i]].first;
+    }
+  }
+  for (u32 i = 0; i < dynlist_size(island_list); ++i) {
+    if (island_list[i].first != NO_ISLAND) {
+      island_list[island_list[i].first] = island_list[i];
+    }
+  }
+  dynlist_resize_no_contract(island_list, kept);
+
+  u32 first = 0;
+  dynlist_each(island_list, island) {
+    island->first = first;
+    first += island->count;
+    island->count = 0;
+  }
+  dynlist_resize(island_bodies, first);
+  for (u32 i = 0; i < body_count; ++i) {
+    if (body_island[i] != NO_ISLAND) {
+      island_t* island = &island_list[body_island[i]];
+      island_bodies[island->first + island->count++] = i;
+    }
+  }
+}
+
+static void solve_islands(void* data, u32 begin, u32 end, u32 worker) {
+  f32 delta_time = *(f32*)data;
+  solver_t* solver = &solver_list[worker];
+  for (u32 i = begin; i < end; ++i) {
+    island_t* island = &island_list[i];
+    island->worker = worker;
+    island->hit_first = dynlist_size(solver->hit_list);
+    solver->island = i;
+    for (u32 b = island->first; b < island->first + island->count; ++b) {
+      solve_body(solver, &body_list[island_bodies[b]], delta_time);
+    }
+    island->hit_count = dynlist_size(solver->hit_list) - island->hit_first;
+  }
+}
+
+static u64 contact_hash(handle_t self, u64 other, u8 kind) {
+  u64 x = self * 0x9E3779B97F4A7C15ull ^ (other + kind);
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// finds the pair, or the slot it would go in: the first tombstone passed or
+// the empty slot that ended the probe
+static contact_t* contact_find(handle_t self, u64 other, u8 kind) {
+  size_t mask = dynlist_size(contact_table) - 1;
+  contact_t* free_slot = NULL;
+  for (size_t i = contact_hash(self, other, kind) & mask;;
+       i = (i + 1) & mask) {
+    contact_t* contact = &contact_table[i];
+    if (contact->slot == CONTACT_SLOT_EMPTY) {
+      return free_slot != NULL ? free_slot : contact;
+    }
+    if (contact->slot == CONTACT_SLOT_REMOVED) {
+      free_slot = free_slot != NULL ? free_slot : contact;
+    } else if (contact->self == self && contact->other == other &&
+               contact->kind == kind) {
+      return contact;
+    }
+  }
+}
+
+// rehashes into a table that stays at most half full, dropping the tombstones
+static void contact_table_rehash(void) {
+  size_t capacity = max(dynlist_size(contact_table), (size_t)64);
+  while ((contact_count + 1) * 2 > capacity) {
+    capacity *= 2;
+  }
+  contact_t* swap = contact_scratch;
+  contact_scratch = contact_table;
+  contact_table = swap;
+  dynlist_resize_no_contract(contact_table, capacity);
+  memset(contact_table, 0, capacity * sizeof(contact_t));
+  contact_removed = 0;
+  dynlist_each(contact_scratch, old) {
+    if (old->slot == CONTACT_SLOT_USED) {
+      *contact_find(old->self, old->other, old->kind) = *old;
+    }
+  }
+}
 
-    // kinematic bodies are normal bodies but do not follow gravity
-    if (!body->is_kinematic) {
-      body->velocity[0] += body->acceleration[0];
-      body->velocity[1] += body->acceleration[1];
-      if (terminal_velocity > body->velocity[1]) {
-        body->velocity[1] = terminal_velocity;
+static void push_event(const contact_t* contact, contact_phase_t phase) {
+  *dynlist_append(event_list) = (collision_event_t){
+      .self = handle_index(contact->self),
+      .other = contact->kind == COLLISION_BODY ? handle_index(contact->other)
+                                               : contact->other,
+      .hit = contact->hit,
+      .kind = contact->kind,
+      .phase = phase,
+  };
+}
+
+static u8 other_layer(const deferred_hit_t* deferred) {
+  switch (deferred->kind) {
+    case COLLISION_BODY:
+      return body_list[deferred->other].collision_layer;
+    case COLLISION_STATIC:
+      return static_body_list[deferred->other].collision_layer;
+    default:
+      return physics_tile_body(deferred->other).collision_layer;
+  }
+}
+
+// the first hit of a pair in an update begins its contact or keeps it going,
+// later ones are only passed to the callbacks
+static void record_contact(const deferred_hit_t* deferred) {
+  if ((contact_count + contact_removed + 1) * 4 >
+      dynlist_size(contact_table) * 3) {
+    contact_table_rehash();
+  }
+  handle_t self = physics_body_handle_at(deferred->self);
+  u64 other = deferred->kind == COLLISION_BODY
+                  ? physics_body_handle_at(deferred->other)
+                  : deferred->other;
+  contact_t* contact = contact_find(self, other, deferred->kind);
+  bool is_new = contact->slot != CONTACT_SLOT_USED;
+  if (!is_new && contact->tick == contact_tick) {
+    return;
+  }
+  if (is_new) {
+    contact_removed -= contact->slot == CONTACT_SLOT_REMOVED;
+    ++contact_count;
+  }
+  *contact = (contact_t){
+      .self = self,
+      .other = other,
+      .hit = deferred->hit,
+      .tick = contact_tick,
+      .other_layer = other_layer(deferred),
+      .slot = CONTACT_SLOT_USED,
+      .kind = deferred->kind,
+  };
+  push_event(contact, is_new ? CONTACT_BEGIN : CONTACT_STAY);
+}
+
+// records the contacts and runs the callbacks of a range of queued hits. the
+// contact goes first since a callback may deactivate either body.
+static void dispatch_hit_range(const deferred_hit_t* hits, u32 count) {
+  for (u32 h = 0; h < count; ++h) {
+    deferred_hit_t deferred = hits[h];
+    record_contact(&deferred);
+
+    body_t* body = physics_body_at(deferred.self);
+    body_callbacks_t callbacks = body_callbacks[deferred.self];
+    if (deferred.kind == COLLISION_BODY) {
+      if (callbacks.on_hit != NULL) {
+        callbacks.on_hit(body, physics_body_at(deferred.other), deferred.hit);
+      }
+    } else if (callbacks.on_hit_static != NULL) {
+      // tiles get a static body made for the call
+      static_body_t tile;
+      static_body_t* other = &tile;
+      if (deferred.kind == COLLISION_STATIC) {
+        other = physics_static_body_get(deferred.other);
+      } else {
+        tile = physics_tile_body(deferred.other);
       }
+      callbacks.on_hit_static(body, other, deferred.hit);
     }
+  }
+}
+
+// runs on the calling thread in island order, so the order does not depend on
+// how the islands were spread over the workers
+static void dispatch_hits(bool is_parallel) {
+  ++contact_tick;
+  dynlist_clear(event_list);
+  if (!is_parallel) {
+    dispatch_hit_range(solver_list[0].hit_list,
+                       dynlist_size(solver_list[0].hit_list));
+    return;
+  }
+  dynlist_each(island_list, island) {
+    solver_t* solver = &solver_list[island->worker];
+    dispatch_hit_range(&solver->hit_list[island->hit_first],
+                       island->hit_count);
+  }
+}
+
+static bool is_body_asleep(handle_t handle) {
+  return physics_body_is_valid(handle) &&
+         handle_index(handle) < dynlist_size(body_asleep) &&
+         body_asleep[handle_index(handle)];
+}
+
+// ends the pairs that did not touch this update. a sleeping body keeps its
+// contacts with statics and other sleepers, it was not swept so it could not
+// have hit them again.
+static void end_contacts(void) {
+  dynlist_each(contact_table, contact) {
+    if (contact->slot != CONTACT_SLOT_USED || contact->tick == contact_tick) {
+      continue;
+    }
+    if (is_body_asleep(contact->self) &&
+        (contact->kind != COLLISION_BODY || is_body_asleep(contact->other))) {
+      contact->tick = contact_tick;
+      continue;
+    }
+    push_event(contact, CONTACT_END);
+    contact->slot = CONTACT_SLOT_REMOVED;
+    --contact_count;
+    ++contact_removed;
+  }
+}
+
+static void touch(handle_t handle, u8 layers, u8 directions) {
+  touching_t* touching = &body_touching[handle_index(handle)];
+  touching->layers |= layers;
+  for (u32 bits = layers; bits != 0; bits &= bits - 1) {
+    touching->directions[__builtin_ctz(bits)] |= directions;
+  }
+}
+
+// contacts count for both bodies of a pair, the other one sees the flipped
+// normal
+static void update_touching(void) {
+  u32 body_count = dynlist_size(body_list);
+  dynlist_resize(body_touching, body_count);
+  for (u32 i = 0; i < body_count; ++i) {
+    body_touching[i] = (touching_t){.generation = body_generations[i]};
+  }
+  dynlist_each(contact_table, contact) {
+    if (contact->slot != CONTACT_SLOT_USED ||
+        !physics_body_is_valid(contact->self)) {
+      continue;
+    }
+    f32 x = contact->hit.normal[0];
+    f32 y = contact->hit.normal[1];
+    touch(contact->self, contact->other_layer, contact_directions(x, y));
+    if (contact->kind == COLLISION_BODY &&
+        physics_body_is_valid(contact->other)) {
+      touch(contact->other,
+            body_list[handle_index(contact->self)].collision_layer,
+            contact_directions(-x, -y));
+    }
+  }
+}
+
+void physics_update(f32 delta_time) {
+  PROFILE_SCOPE("physics");
+  if (fixed_delta > 0) {
+    delta_time = fixed_delta;
+  }
+  iterations = max(iterations, 1u);
+  tick_rate = 1.0f / iterations;
+  {
+    PROFILE_SCOPE("physics broad phase");
+    update_static_bvh();
+    wake_near_static_changes();
+    build_body_broad_phase(delta_time);
+  }
+
+  // deterministic mode solves by island on any thread count, so one thread
+  // gives the same result as many
+  bool is_parallel = thread_count > 1 || fixed_delta > 0;
+  dynlist_each(solver_list, solver) {
+    solver->pairs_tested = 0;
+    solver->clamp_count = 0;
+    solver->island = NO_ISLAND;
+    solver->is_parallel = is_parallel;
+    dynlist_clear(solver->hit_list);
+    dynlist_clear(solver->escaped_list);
+  }
+
+  if (is_parallel) {
+    PROFILE_SCOPE("physics solve");
+    build_islands();
+    jobs_parallel_for(solve_islands, &delta_time, dynlist_size(island_list),
+                      ISLAND_BATCH_SIZE);
+  } else {
+    PROFILE_SCOPE("physics solve");
+    dynlist_each(body_list, body) {
+      solve_body(&solver_list[0], body, delta_time);
+    }
+  }
+  {
+    PROFILE_SCOPE("physics callbacks");
+    dispatch_hits(is_parallel);
+    end_contacts();
+    update_touching();
+  }
+
+  stats.pairs_tested = 0;
+  stats.clamp_count = 0;
+  dynlist_each(solver_list, solver) {
+    stats.pairs_tested += solver->pairs_tested;
+    stats.clamp_count += solver->clamp_count;
+  }
+  stats.island_count = is_parallel ? dynlist_size(island_list) : 0;
+  stats.contact_count = contact_count;
+}
+
+void physics_set_deterministic(f32 tick_delta) { fixed_delta = tick_delta; }
+
+bool physics_is_deterministic(void) { return fixed_delta > 0; }
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+static u64 hash_bytes(u64 hash, const void* data, size_t size) {
+  const u8* bytes = data;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+// fields one at a time, the padding between them is never written
+static u64 hash_aabb(u64 hash, const aabb_t* aabb) {
+  hash = hash_bytes(hash, aabb->position, sizeof(vec2));
+  return hash_bytes(hash, aabb->half_size, sizeof(vec2));
+}
+
+u64 physics_get_state_hash(void) {
+  u64 hash = FNV_OFFSET_BASIS;
+  dynlist_each(body_list, body) {
+    u8 flags = body->is_active | body->is_kinematic << 1 |
+               body->is_sleeping << 2 | body->is_always_awake << 3 |
+               body->is_solid << 4;
+    hash = hash_bytes(hash, &flags, sizeof(flags));
+    if (!body->is_active) {
+      continue;
+    }
+    hash = hash_aabb(hash, &body->aabb);
+    hash = hash_bytes(hash, body->velocity, sizeof(vec2));
+    hash = hash_bytes(hash, body->acceleration, sizeof(vec2));
+    hash = hash_bytes(hash, &body->collision_layer, sizeof(u8));
+    hash = hash_bytes(hash, &body->collision_mask, sizeof(u8));
+    hash = hash_bytes(hash, &body->still_ticks, sizeof(u32));
+  }
+  dynlist_each(static_body_list, static_body) {
+    hash = hash_aabb(hash, &static_body->aabb);
+    hash = hash_bytes(hash, &static_body->collision_layer, sizeof(u8));
+  }
+  dynlist_each(tilemap_list, map) {
+    hash = hash_bytes(hash, map->origin, sizeof(vec2));
+    hash = hash_bytes(hash, map->tile_size, sizeof(vec2));
+    hash = hash_bytes(hash, &map->width, sizeof(u32));
+    hash = hash_bytes(hash, &map->height, sizeof(u32));
+    hash = hash_bytes(hash, map->layers, sizeof(map->layers));
+  }
+  return hash_bytes(hash, tile_list, dynlist_size(tile_list));
+}
 
-    // we are only doing narrow phase sweep, not a broad phase sweep, which may
-    // be necessary for more performance
-    for (u32 i = 0; i < iterations; ++i) {
-      vec2 scaled_velocity;
-      vec2_scale(scaled_velocity, body->velocity, delta_time * tick_rate);
+const collision_event_t* physics_get_events(size_t* count) {
+  *count = dynlist_size(event_list);
+  return event_list;
+}
 
-      sweep_response(body, scaled_velocity);
-      stationary_response(body);
-      physics_clamp_body(body);
+bool physics_body_is_touching(handle_t handle, u8 layer_mask, u8 directions) {
+  u32 idx = handle_index(handle);
+  if (idx >= dynlist_size(body_touching) ||
+      body_touching[idx].generation != handle_generation(handle)) {
+    return false;
+  }
+  touching_t* touching = &body_touching[idx];
+  u32 layers = touching->layers & layer_mask;
+  if (directions == CONTACT_ANY) {
+    return layers != 0;
+  }
+  for (; layers != 0; layers &= layers - 1) {
+    if (touching->directions[__builtin_ctz(layers)] & directions) {
+      return true;
     }
   }
+  return false;
+}
+
+void physics_set_world_bounds(vec2 min, vec2 max) {
+  world_bounds = (bounds_t){{min[0], min[1]}, {max[0], max[1]}};
+}
+
+void physics_set_layer_bounds(u8 layer, vec2 min, vec2 max) {
+  ASSERT(layer != 0 && (layer & (layer - 1)) == 0, "layer must be one bit");
+  layer_bounds[__builtin_ctz(layer)] =
+      (bounds_t){{min[0], min[1]}, {max[0], max[1]}};
+  layer_bounds_mask |= layer;
 }
 
-void physics_clamp_body(body_t* body) {
-  fv2 render_size = render_get_render_size();
+void physics_clear_layer_bounds(u8 layer) { layer_bounds_mask &= ~layer; }
 
-  vec2 min_bounds = {body->aabb.half_size[0], body->aabb.half_size[1]};
-  vec2 max_bounds = {render_size.x - body->aabb.half_size[0],
-                     render_size.y - body->aabb.half_size[1]};
+bool physics_clamp_body(body_t* body) {
+  u8 custom = body->collision_layer & layer_bounds_mask;
+  const bounds_t* bounds =
+      custom != 0 ? &layer_bounds[__builtin_ctz(custom)] : &world_bounds;
+
+  vec2 min_bounds = {bounds->min[0] + body->aabb.half_size[0],
+                     bounds->min[1] + body->aabb.half_size[1]};
+  vec2 max_bounds = {bounds->max[0] - body->aabb.half_size[0],
+                     bounds->max[1] - body->aabb.half_size[1]};
 
   f32 original_x = body->aabb.position[0];
   f32 original_y = body->aabb.position[1];
@@ -185,42 +1656,84 @@ void physics_clamp_body(body_t* body) {
   body->aabb.position[0] = clamp(original_x, min_bounds[0], max_bounds[0]);
   body->aabb.position[1] = clamp(original_y, min_bounds[1], max_bounds[1]);
 
-  if (!float_eq(body->aabb.position[0], original_x) ||
-      !float_eq(body->aabb.position[1], original_y)) {
-    LOG("CLAMPED body position");
-  }
+  return !float_eq(body->aabb.position[0], original_x) ||
+         !float_eq(body->aabb.position[1], original_y);
 }
 
 size_t physics_body_count(void) { return dynlist_size(body_list); }
 
-body_t* physics_body_get(size_t idx) {
+bool physics_body_is_valid(handle_t handle) {
+  u32 idx = handle_index(handle);
+  return idx < dynlist_size(body_generations) &&
+         body_generations[idx] == handle_generation(handle);
+}
+
+body_t* physics_body_get(handle_t handle) {
+  ASSERT(physics_body_is_valid(handle), "stale or invalid body handle");
+  return &body_list[handle_index(handle)];
+}
+
+body_t* physics_body_at(size_t idx) {
   ASSERT(idx < dynlist_size(body_list));
   return &body_list[idx];
 }
 
-size_t physics_body_create(vec2 position, vec2 size, vec2 velocity,
-                           vec2 acceleration, u8 collision_layer,
-                           u8 collision_mask, bool is_kinematic,
-                           on_hit_func on_hit,
-                           on_hit_static_func on_hit_static) {
-  size_t list_size = dynlist_size(body_list);
-  size_t idx = list_size;
-  for (size_t i = 0; i < list_size; ++i) {
-    body_t* body = physics_body_get(i);
-    if (!body->is_active) {
-      idx = i;
-      break;
-    }
-  }
+handle_t physics_body_handle_at(size_t idx) {
+  ASSERT(idx < dynlist_size(body_list));
+  return handle_make(idx, body_generations[idx]);
+}
+
+void physics_body_interpolate(vec2 out, body_t* body, f32 alpha) {
+  out[0] = body->prev_position[0] +
+           (body->aabb.position[0] - body->prev_position[0]) * alpha;
+  out[1] = body->prev_position[1] +
+           (body->aabb.position[1] - body->prev_position[1]) * alpha;
+}
+
+void physics_body_wake(handle_t handle) {
+  wake_body(physics_body_get(handle));
+}
+
+void physics_body_set_callbacks(handle_t handle, on_hit_func on_hit,
+                                on_hit_static_func on_hit_static) {
+  ASSERT(physics_body_is_valid(handle), "stale or invalid body handle");
+  body_callbacks[handle_index(handle)] = (body_callbacks_t){
+      .on_hit = on_hit,
+      .on_hit_static = on_hit_static,
+  };
+}
 
-  if (idx == list_size) {
+handle_t physics_body_create(vec2 position, vec2 size, vec2 velocity,
+                             vec2 acceleration, u8 collision_layer,
+                             u8 collision_mask, bool is_kinematic,
+                             on_hit_func on_hit,
+                             on_hit_static_func on_hit_static) {
+  // dynlist_pop reallocates on every call, shrinking by hand keeps this O(1)
+  size_t idx;
+  size_t free_count = dynlist_size(body_free_list);
+  if (free_count > 0) {
+    idx = body_free_list[free_count - 1];
+    dynlist_resize_no_contract(body_free_list, free_count - 1);
+  } else {
+    idx = dynlist_size(body_list);
     *dynlist_append(body_list) = (body_t){0};
+    *dynlist_append(body_generations) = 1;
+  }
+
+  if (idx >= dynlist_size(body_callbacks)) {
+    dynlist_resize_no_contract(body_callbacks, idx + 1);
   }
+  body_callbacks[idx] = (body_callbacks_t){
+      .on_hit = on_hit,
+      .on_hit_static = on_hit_static,
+  };
 
-  body_t* body = physics_body_get(idx);
+  body_t* body = &body_list[idx];
 
+  // declared out here, a compound literal inside the if would not outlive it
+  vec2 default_acceleration = {DEFAULT_ACCEL_X, DEFAULT_ACCEL_Y};
   if (acceleration == NULL) {
-    acceleration = (vec2){DEFAULT_ACCEL_X, DEFAULT_ACCEL_Y};
+    acceleration = default_acceleration;
   }
 
   *body = (body_t){
@@ -229,17 +1742,146 @@ size_t physics_body_create(vec2 position, vec2 size, vec2 velocity,
               .position = {position[0], position[1]},
               .half_size = {size[0] * 0.5f, size[1] * 0.5f},
           },
+      .prev_position = {position[0], position[1]},
       .velocity = {velocity[0], velocity[1]},
       .acceleration = {acceleration[0], acceleration[1]},
       .collision_layer = collision_layer,
       .collision_mask = collision_mask,
-      .on_hit = on_hit,
-      .on_hit_static = on_hit_static,
       .is_kinematic = is_kinematic,
       .is_active = true,
   };
 
-  return idx;
+  return handle_make(idx, body_generations[idx]);
+}
+
+void physics_body_create_n(size_t count, handle_t* handles, vec2 position,
+                           vec2 size, vec2 velocity, vec2 acceleration,
+                           u8 collision_layer, u8 collision_mask,
+                           bool is_kinematic, on_hit_func on_hit,
+                           on_hit_static_func on_hit_static) {
+  // grow the list once for whatever the free slots can not hold
+  size_t free_count = dynlist_size(body_free_list);
+  size_t needed = dynlist_size(body_list) + (count - min(count, free_count));
+  if (dynlist_capacity(body_list) < needed) {
+    dynlist_ensure(body_list, needed);
+  }
+  if (dynlist_capacity(body_generations) < needed) {
+    dynlist_ensure(body_generations, needed);
+  }
+  if (dynlist_capacity(body_callbacks) < needed) {
+    dynlist_ensure(body_callbacks, needed);
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    handles[i] = physics_body_create(position, size, velocity, acceleration,
+                                     collision_layer, collision_mask,
+                                     is_kinematic, on_hit, on_hit_static);
+  }
+}
+
+// copies a list into another of the same type, growing it only when needed
+#define snapshot_copy(_dst, _src)                                 \
+  do {                                                            \
+    dynlist_resize_no_contract((_dst), dynlist_size(_src));       \
+    memcpy((_dst), (_src), dynlist_size(_src) * sizeof(*(_src))); \
+  } while (0)
+
+void physics_snapshot_init(u32 count) {
+  dynlist_each(snapshot_ring, snapshot) {
+    dynlist_destroy(snapshot->body_list);
+    dynlist_destroy(snapshot->body_generations);
+    dynlist_destroy(snapshot->body_free_list);
+    dynlist_destroy(snapshot->static_body_list);
+    dynlist_destroy(snapshot->tilemap_list);
+    dynlist_destroy(snapshot->tile_list);
+    dynlist_destroy(snapshot->contact_table);
+    dynlist_destroy(snapshot->body_touching);
+  }
+  dynlist_resize(snapshot_ring, count);
+
+  // sized for the world as it is now, so the first saves do not allocate
+  size_t body_count = dynlist_size(body_list);
+  dynlist_each(snapshot_ring, snapshot) {
+    *snapshot = (snapshot_t){
+        .body_list = dynlist_create(body_t, body_count),
+        .body_generations = dynlist_create(u32, body_count),
+        .body_free_list = dynlist_create(u32),
+        .static_body_list =
+            dynlist_create(static_body_t, dynlist_size(static_body_list)),
+        .tilemap_list =
+            dynlist_create(tilemap_t, dynlist_size(tilemap_list)),
+        .tile_list = dynlist_create(u8, dynlist_size(tile_list)),
+        .contact_table =
+            dynlist_create(contact_t, dynlist_size(contact_table)),
+        .body_touching = dynlist_create(touching_t, body_count),
+    };
+  }
+}
+
+u32 physics_snapshot_save(void) {
+  ASSERT(dynlist_size(snapshot_ring) > 0, "call physics_snapshot_init first");
+  u32 id = snapshot_next_id++;
+  snapshot_t* snapshot = &snapshot_ring[id % dynlist_size(snapshot_ring)];
+  snapshot_copy(snapshot->body_list, body_list);
+  snapshot_copy(snapshot->body_generations, body_generations);
+  snapshot_copy(snapshot->body_free_list, body_free_list);
+  snapshot_copy(snapshot->static_body_list, static_body_list);
+  snapshot_copy(snapshot->tilemap_list, tilemap_list);
+  snapshot_copy(snapshot->tile_list, tile_list);
+  snapshot_copy(snapshot->contact_table, contact_table);
+  snapshot_copy(snapshot->body_touching, body_touching);
+  snapshot->contact_count = contact_count;
+  snapshot->contact_removed = contact_removed;
+  snapshot->contact_tick = contact_tick;
+  snapshot->id = id;
+  snapshot->is_saved = true;
+  return id;
+}
+
+bool physics_snapshot_restore(u32 id) {
+  if (dynlist_size(snapshot_ring) == 0) {
+    return false;
+  }
+  snapshot_t* snapshot = &snapshot_ring[id % dynlist_size(snapshot_ring)];
+  if (!snapshot->is_saved || snapshot->id != id) {
+    return false;
+  }
+
+  // the bvh is only rebuilt when the static bodies differ
+  size_t static_count = dynlist_size(snapshot->static_body_list);
+  if (static_count != dynlist_size(static_body_list) ||
+      memcmp(static_body_list, snapshot->static_body_list,
+             static_count * sizeof(static_body_t)) != 0) {
+    snapshot_copy(static_body_list, snapshot->static_body_list);
+    is_static_bvh_dirty = true;
+  }
+
+  snapshot_copy(tilemap_list, snapshot->tilemap_list);
+  snapshot_copy(tile_list, snapshot->tile_list);
+  snapshot_copy(body_list, snapshot->body_list);
+  snapshot_copy(body_generations, snapshot->body_generations);
+  snapshot_copy(body_free_list, snapshot->body_free_list);
+  snapshot_copy(contact_table, snapshot->contact_table);
+  snapshot_copy(body_touching, snapshot->body_touching);
+  contact_count = snapshot->contact_count;
+  contact_removed = snapshot->contact_removed;
+  contact_tick = snapshot->contact_tick;
+  if (dynlist_size(body_callbacks) < dynlist_size(body_list)) {
+    size_t old_size = dynlist_size(body_callbacks);
+    dynlist_resize_no_contract(body_callbacks, dynlist_size(body_list));
+    memset(&body_callbacks[old_size], 0,
+           (dynlist_size(body_list) - old_size) * sizeof(body_callbacks_t));
+  }
+  dynlist_clear(event_list);
+
+  // the broad phase and the escaped lists still hold the ids and bounds from
+  // before, possibly of bodies the snapshot does not have. they are emptied
+  // so that until the next update the queries check every body on its own.
+  broad_phase_build_begin(0);
+  broad_phase_build_end();
+  dynlist_clear(body_fat_aabbs);
+  dynlist_each(solver_list, solver) { dynlist_clear(solver->escaped_list); }
+  return true;
 }
 
 size_t physics_static_body_count(void) {
@@ -251,8 +1893,11 @@ static_body_t* physics_static_body_get(size_t idx) {
   return &static_body_list[idx];
 }
 
+void physics_static_body_mark_dirty(void) { is_static_bvh_dirty = true; }
+
 size_t physics_static_body_create(vec2 position, vec2 size,
                                   u8 collision_layer) {
+  is_static_bvh_dirty = true;
   *dynlist_append(static_body_list) = (static_body_t){
       .aabb = {.position = {position[0], position[1]},
                .half_size = {size[0] * 0.5f, size[1] * 0.5f}},
@@ -262,6 +1907,185 @@ size_t physics_static_body_create(vec2 position, vec2 size,
   return dynlist_size(static_body_list) - 1;
 }
 
+size_t physics_tilemap_count(void) { return dynlist_size(tilemap_list); }
+
+size_t physics_tilemap_create(vec2 origin, vec2 tile_size, u32 width,
+                              u32 height) {
+  ASSERT(tile_size[0] > 0 && tile_size[1] > 0);
+  size_t first = dynlist_size(tile_list);
+  size_t count = (size_t)width * height;
+  dynlist_resize(tile_list, first + count);
+  memset(&tile_list[first], 0, count);
+
+  tilemap_t* map = dynlist_append(tilemap_list);
+  *map = (tilemap_t){
+      .origin = {origin[0], origin[1]},
+      .tile_size = {tile_size[0], tile_size[1]},
+      .width = width,
+      .height = height,
+      .first = first,
+  };
+  return dynlist_size(tilemap_list) - 1;
+}
+
+// bodies asleep on or against the changed tiles are woken by the next update
+static void mark_tiles_changed(aabb_t bounds) {
+  bounds.half_size[0] += STATIC_WAKE_MARGIN;
+  bounds.half_size[1] += STATIC_WAKE_MARGIN;
+  *dynlist_append(static_changes) = bounds;
+}
+
+static aabb_t tilemap_aabb(const tilemap_t* map) {
+  vec2 half_size = {map->width * map->tile_size[0] * 0.5f,
+                    map->height * map->tile_size[1] * 0.5f};
+  return (aabb_t){
+      .position = {map->origin[0] + half_size[0],
+                   map->origin[1] + half_size[1]},
+      .half_size = {half_size[0], half_size[1]},
+  };
+}
+
+void physics_tilemap_set_layer(size_t tilemap, u8 id, u8 collision_layer) {
+  ASSERT(tilemap < dynlist_size(tilemap_list));
+  tilemap_t* map = &tilemap_list[tilemap];
+  map->layers[id] = collision_layer;
+  mark_tiles_changed(tilemap_aabb(map));
+}
+
+void physics_tilemap_set_tiles(size_t tilemap, const u8* ids) {
+  ASSERT(tilemap < dynlist_size(tilemap_list));
+  tilemap_t* map = &tilemap_list[tilemap];
+  memcpy(&tile_list[map->first], ids, (size_t)map->width * map->height);
+  mark_tiles_changed(tilemap_aabb(map));
+}
+
+size_t physics_tilemap_tile(size_t tilemap, u32 x, u32 y) {
+  ASSERT(tilemap < dynlist_size(tilemap_list));
+  tilemap_t* map = &tilemap_list[tilemap];
+  ASSERT(x < map->width && y < map->height);
+  return map->first + (size_t)y * map->width + x;
+}
+
+u8 physics_tile_get(size_t tile) {
+  ASSERT(tile < dynlist_size(tile_list));
+  return tile_list[tile];
+}
+
+void physics_tile_set(size_t tile, u8 id) {
+  ASSERT(tile < dynlist_size(tile_list));
+  if (tile_list[tile] == id) {
+    return;
+  }
+  tile_list[tile] = id;
+  mark_tiles_changed(physics_tile_body(tile).aabb);
+}
+
+static_body_t physics_tile_body(size_t tile) {
+  tilemap_t* map = tile_map(tile);
+  u32 x = (tile - map->first) % map->width;
+  u32 y = (tile - map->first) / map->width;
+  return (static_body_t){
+      .aabb = tile_aabb(map, x, y),
+      .collision_layer = tile_layer(map, x, y),
+  };
+}
+
+static void query_push(query_result_t* results, size_t capacity,
+                       size_t* count, size_t id, bool is_static) {
+  if (*count < capacity) {
+    results[*count] = (query_result_t){.id = id, .is_static = is_static};
+  }
+  ++*count;
+}
+
+size_t physics_overlap_aabb(aabb_t aabb, u8 mask, query_result_t* results,
+                            size_t capacity) {
+  size_t count = 0;
+  vec2 min, max;
+  aabb_min_max(min, max, aabb);
+
+  update_static_bvh();
+  dynlist_clear(query_list);
+  bvh_query(&static_bvh, min, max, &query_list);
+  dynlist_each(query_list, id) {
+    static_body_t* static_body = &static_body_list[*id];
+    if ((mask & static_body->collision_layer) != 0 &&
+        physics_aabb_intersect_aabb(static_body->aabb, aabb)) {
+      query_push(results, capacity, &count, *id, true);
+    }
+  }
+
+  query_bodies(min, max);
+  dynlist_each(query_list, id) {
+    body_t* body = &body_list[*id];
+    if (body->is_active && (mask & body->collision_layer) != 0 &&
+        physics_aabb_intersect_aabb(body->aabb, aabb)) {
+      query_push(results, capacity, &count, *id, false);
+    }
+  }
+
+  return count;
+}
+
+size_t physics_query_point(vec2 point, u8 mask, query_result_t* results,
+                           size_t capacity) {
+  aabb_t aabb = {.position = {point[0], point[1]}};
+  return physics_overlap_aabb(aabb, mask, results, capacity);
+}
+
+// keeps the earliest hit, candidates come in ascending order so ties go to
+// statics first and then to the lowest id
+static void raycast_candidate(raycast_hit_t* best, vec2 origin,
+                              vec2 direction, aabb_t aabb, size_t id,
+                              bool is_static) {
+  hit_t hit = ray_intersect_aabb(origin, direction, aabb);
+  if (!hit.is_hit) {
+    return;
+  }
+  if (hit.time < 0) {
+    hit.time = 0;
+    hit.position[0] = origin[0];
+    hit.position[1] = origin[1];
+  }
+  if (!best->hit.is_hit || hit.time < best->hit.time) {
+    hit.other_id = id;
+    best->hit = hit;
+    best->is_static = is_static;
+  }
+}
+
+bool physics_raycast(vec2 origin, vec2 direction, u8 mask,
+                     raycast_hit_t* result) {
+  raycast_hit_t best = {0};
+
+  update_static_bvh();
+  dynlist_clear(query_list);
+  bvh_query_ray(&static_bvh, origin, direction, (vec2){0, 0}, &query_list);
+  dynlist_each(query_list, id) {
+    static_body_t* static_body = &static_body_list[*id];
+    if ((mask & static_body->collision_layer) != 0) {
+      raycast_candidate(&best, origin, direction, static_body->aabb, *id,
+                        true);
+    }
+  }
+
+  aabb_t segment = {.position = {origin[0], origin[1]}};
+  vec2 min, max;
+  swept_min_max(min, max, segment, direction);
+  query_bodies(min, max);
+  dynlist_each(query_list, id) {
+    body_t* body = &body_list[*id];
+    if (body->is_active && (mask & body->collision_layer) != 0) {
+      raycast_candidate(&best, origin, direction, body->aabb, *id, false);
+    }
+  }
+
+  if (best.hit.is_hit && result != NULL) {
+    *result = best;
+  }
+  return best.hit.is_hit;
+}
+
 bool physics_point_intersect_aabb(vec2 point, aabb_t aabb) {
   vec2 min, max;
   aabb_min_max(min, max, aabb);
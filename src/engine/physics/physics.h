@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../c-lib/handle.h"
 #include "../c-lib/types.h"
 #include "../math/math.h"
 
@@ -16,16 +17,30 @@ typedef struct {
   vec2 half_size;
 } aabb_t;
 
+// the record handed out by physics_body_get. the solver keeps a structure of
+// arrays copy of the aabb, layer and mask for the sweeps, refreshed from this
+// at the start of every update, so writes here are always picked up. the hit
+// callbacks are kept apart, see physics_body_set_callbacks.
 struct body {
   aabb_t aabb;
+  vec2 prev_position; // aabb position before the last physics_update
   vec2 velocity;
   vec2 acceleration;
-  on_hit_func on_hit;
-  on_hit_static_func on_hit_static;
   u8 collision_layer;
   u8 collision_mask;
+  u32 still_ticks; // ticks in a row spent under the sleep threshold
   bool is_kinematic;
+  // stops at other solid bodies instead of only reporting them. each body
+  // stops at the earliest solid or static hit of its own sweep, bodies are
+  // still moved one after the other rather than in time of impact order
+  // across the island, so a body can stop where another one only arrives
+  // later in the same sweep. pairs that already overlap are not separated
+  // here, so create solid bodies apart.
+  bool is_solid;
   bool is_active;
+  bool is_sleeping;     // skipped by the solver until woken
+  bool is_always_awake; // never put to sleep, for bodies whose callbacks
+                        // have to keep running while they stand still
 };
 
 struct static_body {
@@ -34,33 +49,233 @@ struct static_body {
 };
 
 struct hit {
-  size_t other_id;
+  size_t other_id; // list index, see physics_body_handle_at for bodies, or
+                   // tile id for tiles
   f32 time;
   vec2 position;
   vec2 normal;
   bool is_hit;
 };
 
-void physics_init(void);
+// a body or static body found by a spatial query
+typedef struct {
+  size_t id; // list index, see physics_body_handle_at for bodies
+  bool is_static;
+} query_result_t;
+
+typedef struct {
+  hit_t hit; // other_id is a body or static body id, as in query_result_t
+  bool is_static;
+} raycast_hit_t;
+
+typedef enum {
+  COLLISION_BODY,
+  COLLISION_STATIC,
+  COLLISION_TILE,
+} collision_kind_t;
+
+typedef enum {
+  CONTACT_BEGIN, // the pair did not touch during the update before
+  CONTACT_STAY,  // the pair touched during both updates
+  CONTACT_END,   // the pair stopped touching, hit is the last one it had
+} contact_phase_t;
+
+// one per pair and update. self is a body index, other a body or static body
+// index or a tile id depending on kind, and hit the pair's first hit of the
+// update.
+typedef struct {
+  size_t self;
+  size_t other;
+  hit_t hit;
+  collision_kind_t kind;
+  contact_phase_t phase;
+} collision_event_t;
+
+// which way a contact normal points, from the other side toward the body. a
+// body standing on something touches it with CONTACT_UP.
+enum {
+  CONTACT_UP = 1 << 0,
+  CONTACT_DOWN = 1 << 1,
+  CONTACT_LEFT = 1 << 2,
+  CONTACT_RIGHT = 1 << 3,
+  CONTACT_ANY = 0xF,
+};
+
+typedef struct {
+  u32 pairs_tested; // narrow phase tests run during the last physics_update
+  u32 island_count; // groups of bodies solved independently, parallel or
+                    // deterministic mode only
+  u32 sleeping_count; // bodies skipped by the last physics_update
+  u32 clamp_count;    // times a body was pushed back inside its bounds
+  u32 contact_count;  // pairs in the contact cache
+} physics_stats_t;
+
+// how bodies find the others near them, static bodies are always in a bvh.
+// bodies go in with the bounds they can reach during the update, so the choice
+// only changes the cost. the exception is a body pushed out of those bounds,
+// the grid can still find it by its cells where the others do not.
+typedef enum {
+  // uniform grid stored as a spatial hash, see physics_get_cell_size. the
+  // default, best when bodies are about the same size
+  BROAD_PHASE_GRID,
+  // sweep and prune along the axis bodies spread out the most on, kept
+  // sorted from one update to the next. needs no tuning and copes with
+  // bodies of very different sizes or packed unevenly along one axis
+  BROAD_PHASE_SAP,
+  // every body against every other, for reference and benchmarks only
+  BROAD_PHASE_BRUTE,
+} broad_phase_t;
+
+void physics_init(broad_phase_t broad_phase);
 void physics_destroy(void);
-void physics_deactivate(size_t idx);
+void physics_deactivate(handle_t body);
 
 f32* physics_get_terminal_velocity(void);
+broad_phase_t physics_get_broad_phase(void);
+f32* physics_get_cell_size(void);
+// sweeps per body and tick, each covering an equal part of the motion, 2 by
+// default. bodies that are not solid only report each other, once per sweep,
+// and fast ones can step past each other between sweeps. games whose moving
+// bodies are all solid can lower it to 1, the bullets scene of the bench
+// checks that solid bodies do not pass through each other then.
+u32* physics_get_iterations(void);
+// a body that moves slower than the threshold (units per second) for
+// sleep_ticks ticks in a row is put to sleep, 0 ticks disables sleeping.
+// sleeping bodies stay in the broad phase but are neither integrated nor
+// swept. they wake when another body sweeps into them, when their velocity or
+// position is written, or when a static body near them is created or marked
+// dirty after moving.
+u32* physics_get_sleep_ticks(void);
+f32* physics_get_sleep_threshold(void);
+physics_stats_t physics_get_stats(void);
+
+// solves bodies on a pool of count threads (0 for one per cpu, 1 to go back to
+// a single thread). bodies are split into islands that cannot reach each other
+// this update, each solved in order on one thread.
+void physics_set_thread_count(u32 count);
+u32 physics_get_thread_count(void);
 
+// advances every body by one tick of delta_time seconds, acceleration is
+// added to the velocity once per tick. for results that do not depend on the
+// frame rate call it state.time.tick_count times with state.time.tick_delta
+// after setting a tick rate with time_set_tick_rate.
+// hits are queued during the solve and on_hit and on_hit_static run on the
+// calling thread at the end of the update, so callbacks see every body at its
+// final position and never change one that is still being solved.
 void physics_update(f32 delta_time);
-void physics_clamp_body(body_t* body);
+// deterministic mode for lockstep and replays. every update advances exactly
+// tick_delta seconds whatever physics_update is given, broad phase candidates
+// are visited in id order so ties between equal hit times always resolve the
+// same way, and bodies are solved by island even on one thread so the result
+// does not depend on the thread count. 0 turns it off. builds must keep
+// -ffp-contract=off (see the makefile) for results to match across machines.
+void physics_set_deterministic(f32 tick_delta);
+bool physics_is_deterministic(void);
+// fnv-1a over the bit patterns of every body and static body, two runs are in
+// step as long as their hashes after each update match
+u64 physics_get_state_hash(void);
+// the contact events of the last update, begins and stays in the order the
+// hits were dispatched followed by the ends. valid until the next update.
+const collision_event_t* physics_get_events(size_t* count);
+// contacts are kept in a cache from one update to the next, a pair touches
+// from its first hit until an update goes by without one. a sleeping body
+// keeps touching what it rested on. true when the body touched a layer in
+// layer_mask during the last update with a normal in one of directions. both
+// bodies of a pair touch each other, whichever one swept into the other.
+bool physics_body_is_touching(handle_t body, u8 layer_mask, u8 directions);
 
+// bodies are clamped inside the world bounds, which are unbounded until set.
+// a layer can be given bounds of its own, bodies use those of the lowest
+// layer bit that has any and the world bounds otherwise. layer is one bit.
+void physics_set_world_bounds(vec2 min, vec2 max);
+void physics_set_layer_bounds(u8 layer, vec2 min, vec2 max);
+void physics_clear_layer_bounds(u8 layer);
+// returns true when the body had to be moved, counted in clamp_count
+bool physics_clamp_body(body_t* body);
+
+// bodies are referred to by generational handles, which stop being valid once
+// the body is deactivated. pointers from physics_body_get are only good until
+// the next body is created, keep the handle across frames instead.
 size_t physics_body_count(void);
-body_t* physics_body_get(size_t idx);
-size_t physics_body_create(vec2 position, vec2 size, vec2 velocity,
-                           vec2 acceleration, u8 collision_layer,
-                           u8 collision_mask, bool is_kinematic,
-                           on_hit_func on_hit,
+bool physics_body_is_valid(handle_t body);
+body_t* physics_body_get(handle_t body);
+// slot access for walking every body (active or not) by index
+body_t* physics_body_at(size_t idx);
+handle_t physics_body_handle_at(size_t idx);
+// position between the previous and current tick, alpha from state.time.alpha
+void physics_body_interpolate(vec2 out, body_t* body, f32 alpha);
+void physics_body_wake(handle_t body);
+void physics_body_set_callbacks(handle_t body, on_hit_func on_hit,
+                                on_hit_static_func on_hit_static);
+handle_t physics_body_create(vec2 position, vec2 size, vec2 velocity,
+                             vec2 acceleration, u8 collision_layer,
+                             u8 collision_mask, bool is_kinematic,
+                             on_hit_func on_hit,
+                             on_hit_static_func on_hit_static);
+// creates count identical bodies, writing their handles to handles. the body
+// list grows at most once, change positions/velocities through the handles.
+void physics_body_create_n(size_t count, handle_t* handles, vec2 position,
+                           vec2 size, vec2 velocity, vec2 acceleration,
+                           u8 collision_layer, u8 collision_mask,
+                           bool is_kinematic, on_hit_func on_hit,
                            on_hit_static_func on_hit_static);
 
+// rollback: a ring of count snapshots, each save takes the oldest slot. a
+// snapshot holds every body and static body, the free slots and the contact
+// cache, the lists are copied flat and grow to fit so saving does not
+// allocate once they have. callbacks are not part of it, a slot keeps the
+// ones it was last created or set with. the spatial queries answer from the
+// last update until the next one has run, or after a restore by checking
+// every restored body. ids count up from 0 and restoring one that was
+// overwritten returns false.
+void physics_snapshot_init(u32 count);
+u32 physics_snapshot_save(void);
+bool physics_snapshot_restore(u32 id);
+
 size_t physics_static_body_count(void);
 static_body_t* physics_static_body_get(size_t idx);
 size_t physics_static_body_create(vec2 position, vec2 size, u8 collision_layer);
+// static bodies are kept in a bvh, call this after moving or resizing any
+void physics_static_body_mark_dirty(void);
+
+// tilemaps hold level geometry laid out on a grid at one byte per tile, where
+// a static body each would take over 20. a tile holds an id and every map
+// gives each id a collision layer, 0 (the default) for ids nothing collides
+// with. tile (0, 0) has its lower left corner at origin and rows go up from
+// there. sweeps walk the tiles a body passes through in the order it reaches
+// them, so they cost as much as the distance moved whatever the map's size.
+// tiles are told apart by tile ids that count on from one map to the next.
+// hits on tiles are reported like static hits with other_id set to the tile
+// id, on_hit_static gets a static body made for the tile that is only good
+// during the call. the spatial queries below do not see tiles.
+size_t physics_tilemap_count(void);
+size_t physics_tilemap_create(vec2 origin, vec2 tile_size, u32 width,
+                              u32 height);
+void physics_tilemap_set_layer(size_t tilemap, u8 id, u8 collision_layer);
+// width * height ids, row by row from the bottom one
+void physics_tilemap_set_tiles(size_t tilemap, const u8* ids);
+size_t physics_tilemap_tile(size_t tilemap, u32 x, u32 y);
+u8 physics_tile_get(size_t tile);
+void physics_tile_set(size_t tile, u8 id);
+// the tile's box and collision layer
+static_body_t physics_tile_body(size_t tile);
+
+// spatial queries over the bodies and static bodies whose collision layer is
+// in mask, answered from the same broad phase and bvh the solver uses. bodies
+// are looked up as of the last physics_update, which covers everything
+// the solver did, a body moved by hand since then is only found where it was
+// until the next update has run.
+// overlap and point queries write up to capacity results in ascending id
+// order (statics first) and return the total number found, which can be more
+// than capacity. nothing is allocated once the internal scratch has grown.
+size_t physics_overlap_aabb(aabb_t aabb, u8 mask, query_result_t* results,
+                            size_t capacity);
+size_t physics_query_point(vec2 point, u8 mask, query_result_t* results,
+                           size_t capacity);
+// the first box hit by the segment from origin to origin + direction, rays
+// starting inside a box hit it at time 0. result may be NULL.
+bool physics_raycast(vec2 origin, vec2 direction, u8 mask,
+                     raycast_hit_t* result);
 
 bool physics_point_intersect_aabb(vec2 point, aabb_t aabb);
 bool physics_aabb_intersect_aabb(aabb_t a, aabb_t b);
@@ -0,0 +1,222 @@
+#include "sap.h"
+
+#include <stdlib.h>
+
+#include "../c-lib/math.h"
+#include "../c-lib/misc.h"
+
+// items longer than this many times the average on the sorted axis would
+// widen every query, they are kept on the side instead
+#define SAP_LARGE_FACTOR 16
+// the other axis has to spread items this much more before the entries are
+// sorted along it, so that they are not sorted from scratch back and forth
+#define SAP_AXIS_HYSTERESIS 1.25
+// insertion sort shifts per entry before giving up on the old order, a build
+// that moved most items far (or the first one) is sorted from scratch
+#define SAP_MAX_SHIFTS 8
+
+static int cmp_u32(const void* a, const void* b) {
+  u32 x = *(const u32*)a, y = *(const u32*)b;
+  return (x > y) - (x < y);
+}
+
+static bool entry_less(sap_entry_t a, sap_entry_t b) {
+  return a.min < b.min || (a.min <= b.min && a.id < b.id);
+}
+
+static int cmp_entry(const void* a, const void* b) {
+  sap_entry_t x = *(const sap_entry_t*)a, y = *(const sap_entry_t*)b;
+  return entry_less(x, y) ? -1 : entry_less(y, x);
+}
+
+static bool bounds_overlap(sap_bounds_t b, vec2 min, vec2 max) {
+  return b.min[0] <= max[0] && b.max[0] >= min[0] && b.min[1] <= max[1] &&
+         b.max[1] >= min[1];
+}
+
+static bool is_set(sap_bounds_t b) { return b.min[0] <= b.max[0]; }
+
+void sap_init(sap_t* sap) {
+  *sap = (sap_t){
+      .entries = dynlist_create(sap_entry_t),
+      .large = dynlist_create(u32),
+      .items = dynlist_create(sap_bounds_t),
+      .seen = dynlist_create(bool),
+  };
+}
+
+void sap_destroy(sap_t* sap) {
+  dynlist_destroy(sap->entries);
+  dynlist_destroy(sap->large);
+  dynlist_destroy(sap->items);
+  dynlist_destroy(sap->seen);
+}
+
+void sap_build_begin(sap_t* sap, size_t count) {
+  dynlist_resize(sap->items, count);
+  for (size_t i = 0; i < count; ++i) {
+    sap->items[i] = (sap_bounds_t){
+        .min = {INFINITY, INFINITY},
+        .max = {-INFINITY, -INFINITY},
+    };
+  }
+}
+
+void sap_set(sap_t* sap, u32 id, vec2 min, vec2 max) {
+  ASSERT(id < dynlist_size(sap->items));
+  sap->items[id] = (sap_bounds_t){
+      .min = {min[0], min[1]},
+      .max = {max[0], max[1]},
+  };
+}
+
+// sorts along the axis the centers spread out the most on, and returns
+// whether that is a different one than before
+static bool choose_axis(sap_t* sap) {
+  f64 sum[2] = {0}, sum_sq[2] = {0};
+  size_t set_count = 0;
+  dynlist_each(sap->items, item) {
+    if (!is_set(*item)) {
+      continue;
+    }
+    for (u8 i = 0; i < 2; ++i) {
+      f64 center = ((f64)item->min[i] + item->max[i]) * 0.5;
+      sum[i] += center;
+      sum_sq[i] += center * center;
+    }
+    ++set_count;
+  }
+  if (set_count == 0) {
+    return false;
+  }
+
+  f64 variance[2];
+  for (u8 i = 0; i < 2; ++i) {
+    f64 mean = sum[i] / set_count;
+    variance[i] = sum_sq[i] / set_count - mean * mean;
+  }
+  u8 other = !sap->axis;
+  if (variance[other] > variance[sap->axis] * SAP_AXIS_HYSTERESIS) {
+    sap->axis = other;
+    return true;
+  }
+  return false;
+}
+
+static void sort_entries(sap_t* sap, bool is_axis_changed) {
+  size_t count = dynlist_size(sap->entries);
+  sap_entry_t* entries = sap->entries;
+  if (!is_axis_changed) {
+    size_t shifts = 0;
+    size_t max_shifts = count * SAP_MAX_SHIFTS;
+    size_t i = 1;
+    for (; i < count && shifts <= max_shifts; ++i) {
+      sap_entry_t entry = entries[i];
+      size_t j = i;
+      for (; j > 0 && entry_less(entry, entries[j - 1]); --j) {
+        entries[j] = entries[j - 1];
+      }
+      entries[j] = entry;
+      shifts += i - j;
+    }
+    if (i == count) {
+      return;
+    }
+  }
+  qsort(entries, count, sizeof(sap_entry_t), cmp_entry);
+}
+
+void sap_build_end(sap_t* sap) {
+  bool is_axis_changed = choose_axis(sap);
+  u8 axis = sap->axis;
+  size_t count = dynlist_size(sap->items);
+
+  f64 length_sum = 0;
+  size_t set_count = 0;
+  dynlist_each(sap->items, item) {
+    if (is_set(*item)) {
+      length_sum += item->max[axis] - item->min[axis];
+      ++set_count;
+    }
+  }
+  f32 large_length =
+      set_count > 0 ? (f32)(length_sum / set_count) * SAP_LARGE_FACTOR : 0;
+
+  // entries from the last build keep their order, only their bounds are
+  // refreshed. items that are gone or became large are dropped.
+  dynlist_resize(sap->seen, count);
+  memset(sap->seen, 0, count * sizeof(bool));
+  size_t kept = 0;
+  dynlist_each(sap->entries, entry) {
+    if (entry->id >= count) {
+      continue;
+    }
+    sap_bounds_t item = sap->items[entry->id];
+    if (!is_set(item) || item.max[axis] - item.min[axis] > large_length) {
+      continue;
+    }
+    sap->seen[entry->id] = true;
+    sap->entries[kept++] = (sap_entry_t){item.min[axis], entry->id};
+  }
+  dynlist_resize_no_contract(sap->entries, kept);
+
+  dynlist_clear(sap->large);
+  for (u32 id = 0; id < count; ++id) {
+    sap_bounds_t item = sap->items[id];
+    if (!is_set(item) || sap->seen[id]) {
+      continue;
+    }
+    if (item.max[axis] - item.min[axis] > large_length) {
+      *dynlist_append(sap->large) = id;
+    } else {
+      *dynlist_append(sap->entries) = (sap_entry_t){item.min[axis], id};
+    }
+  }
+
+  sort_entries(sap, is_axis_changed);
+
+  sap->max_length = 0;
+  dynlist_each(sap->entries, entry) {
+    sap_bounds_t item = sap->items[entry->id];
+    sap->max_length = max(sap->max_length, item.max[axis] - item.min[axis]);
+  }
+}
+
+size_t sap_query(const sap_t* sap, vec2 min, vec2 max, u32** out) {
+  size_t first = dynlist_size(*out);
+  u8 axis = sap->axis;
+
+  // nothing that starts before lo reaches min, the slack covers the rounding
+  // of the subtraction
+  f32 lo = min[axis] - sap->max_length;
+  lo -= fabsf(lo) * 1e-6f + 1e-6f;
+  size_t begin = 0, end = dynlist_size(sap->entries);
+  while (begin < end) {
+    size_t mid = (begin + end) / 2;
+    if (sap->entries[mid].min < lo) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+
+  for (size_t i = begin; i < dynlist_size(sap->entries); ++i) {
+    sap_entry_t entry = sap->entries[i];
+    if (entry.min > max[axis]) {
+      break;
+    }
+    if (bounds_overlap(sap->items[entry.id], min, max)) {
+      *dynlist_append(*out) = entry.id;
+    }
+  }
+  for (size_t i = 0; i < dynlist_size(sap->large); ++i) {
+    u32 id = sap->large[i];
+    if (bounds_overlap(sap->items[id], min, max)) {
+      *dynlist_append(*out) = id;
+    }
+  }
+
+  size_t added = dynlist_size(*out) - first;
+  qsort(*out + first, added, sizeof(u32), cmp_u32);
+  return added;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../c-lib/dynlist.h"
+#include "../c-lib/types.h"
+#include "../math/math.h"
+
+// sweep and prune broad phase, items are kept sorted by their lower bound on
+// the axis they spread out the most along. the order is kept from one build
+// to the next and fixed up with an insertion sort, which is close to linear
+// while items move little between builds. memory only depends on the item
+// count, not on how spread out they are. items are referenced by their index
+// in the owning list.
+typedef struct {
+  vec2 min, max; // min[0] > max[0] when the item is not set
+} sap_bounds_t;
+
+typedef struct {
+  f32 min; // lower bound on the sorted axis
+  u32 id;
+} sap_entry_t;
+
+typedef struct {
+  u8 axis;        // axis the entries are sorted along
+  f32 max_length; // longest entry along the axis, bounds the query scan
+  DYNLIST(sap_entry_t) entries; // ascending min, then id
+  DYNLIST(u32) large; // items much longer than the rest, tested one by one
+  DYNLIST(sap_bounds_t) items; // bounds of every item by id
+  DYNLIST(bool) seen; // build scratch, whether an item is among the entries
+} sap_t;
+
+void sap_init(sap_t* sap);
+void sap_destroy(sap_t* sap);
+
+// rebuilding: begin with the item count, set the bounds of every item that
+// should be present (unset items are skipped), then end to sort them.
+void sap_build_begin(sap_t* sap, size_t count);
+void sap_set(sap_t* sap, u32 id, vec2 min, vec2 max);
+void sap_build_end(sap_t* sap);
+
+// appends the ids of all items overlapping [min, max] to out, in ascending
+// order so the results match a linear scan. returns the count added. safe to
+// call from several threads as long as nothing is building.
+size_t sap_query(const sap_t* sap, vec2 min, vec2 max, u32** out);
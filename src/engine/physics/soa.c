@@ -0,0 +1,128 @@
+#include "soa.h"
+
+#include <math.h>
+
+#include "../c-lib/math.h"
+
+void aabb_soa_init(aabb_soa_t* soa) {
+  *soa = (aabb_soa_t){
+      .x = dynlist_create(f32),
+      .y = dynlist_create(f32),
+      .hx = dynlist_create(f32),
+      .hy = dynlist_create(f32),
+      .layer = dynlist_create(u8),
+      .mask = dynlist_create(u8),
+  };
+}
+
+void aabb_soa_destroy(aabb_soa_t* soa) {
+  dynlist_destroy(soa->x);
+  dynlist_destroy(soa->y);
+  dynlist_destroy(soa->hx);
+  dynlist_destroy(soa->hy);
+  dynlist_destroy(soa->layer);
+  dynlist_destroy(soa->mask);
+}
+
+void aabb_soa_resize(aabb_soa_t* soa, size_t count) {
+  dynlist_resize(soa->x, count);
+  dynlist_resize(soa->y, count);
+  dynlist_resize(soa->hx, count);
+  dynlist_resize(soa->hy, count);
+  dynlist_resize(soa->layer, count);
+  dynlist_resize(soa->mask, count);
+}
+
+void sweep_batch_test(const sweep_batch_t* batch, const vec2 position,
+                      const vec2 half_size, const vec2 velocity,
+                      u32 is_hit[SWEEP_BATCH_WIDTH]) {
+  // the velocity is the same for every lane, so the zero velocity cases of
+  // ray_intersect_aabb are folded into clamps on the entry/exit times rather
+  // than branches. the min/max macros are used over fminf/fmaxf since they
+  // vectorize without fast-math, the values here are never NaN.
+  const bool is_moving_x = fabsf(velocity[0]) > 0.0f;
+  const bool is_moving_y = fabsf(velocity[1]) > 0.0f;
+  const f32 vx = is_moving_x ? velocity[0] : 1.0f;
+  const f32 vy = is_moving_y ? velocity[1] : 1.0f;
+  const f32 entry_cap_x = is_moving_x ? INFINITY : -INFINITY;
+  const f32 entry_cap_y = is_moving_y ? INFINITY : -INFINITY;
+  const f32 px = position[0], py = position[1];
+  const u32 count = batch->count;
+
+  for (u32 lane = 0; lane < SWEEP_BATCH_WIDTH; ++lane) {
+    // minkowski sum of the two boxes, matching update_sweep_result
+    f32 sx = batch->hx[lane] + half_size[0];
+    f32 sy = batch->hy[lane] + half_size[1];
+    f32 min_x = batch->x[lane] - sx, max_x = batch->x[lane] + sx;
+    f32 min_y = batch->y[lane] - sy, max_y = batch->y[lane] + sy;
+
+    f32 tx1 = (min_x - px) / vx, tx2 = (max_x - px) / vx;
+    f32 ty1 = (min_y - py) / vy, ty2 = (max_y - py) / vy;
+
+    // a still axis never limits the entry/exit times
+    f32 entry_x = min(min(tx1, tx2), entry_cap_x);
+    f32 exit_x = max(max(tx1, tx2), -entry_cap_x);
+    f32 entry_y = min(min(ty1, ty2), entry_cap_y);
+    f32 exit_y = max(max(ty1, ty2), -entry_cap_y);
+
+    // but it only hits when the position is strictly inside the box
+    bool is_inside_x = is_moving_x | ((px > min_x) & (px < max_x));
+    bool is_inside_y = is_moving_y | ((py > min_y) & (py < max_y));
+
+    f32 last_entry = max(entry_x, entry_y);
+    f32 first_exit = min(exit_x, exit_y);
+
+    is_hit[lane] = (lane < count) & is_inside_x & is_inside_y &
+                   (first_exit > last_entry) & (first_exit > 0) &
+                   (last_entry < 1);
+  }
+}
+
+void sweep_batch_penetration(const sweep_batch_t* batch, const vec2 position,
+                             const vec2 half_size,
+                             u32 is_hit[SWEEP_BATCH_WIDTH],
+                             f32 push_x[SWEEP_BATCH_WIDTH],
+                             f32 push_y[SWEEP_BATCH_WIDTH]) {
+  const f32 px = position[0], py = position[1];
+  const f32 hx = half_size[0], hy = half_size[1];
+  const u32 count = batch->count;
+  // the lanes are filled in locally and copied out after, the outputs could
+  // alias the batch as far as the compiler knows and it would not vectorize
+  u32 hit[SWEEP_BATCH_WIDTH];
+  f32 out_x[SWEEP_BATCH_WIDTH], out_y[SWEEP_BATCH_WIDTH];
+
+  for (u32 lane = 0; lane < SWEEP_BATCH_WIDTH; ++lane) {
+    // the same minkowski difference physics_aabb_intersect_aabb takes, so the
+    // two always agree
+    f32 dx = batch->x[lane] - px, dy = batch->y[lane] - py;
+    f32 sx = batch->hx[lane] + hx;
+    f32 sy = batch->hy[lane] + hy;
+    f32 min_x = dx - sx, max_x = dx + sx;
+    f32 min_y = dy - sy, max_y = dy + sy;
+
+    hit[lane] = (lane < count) & (min_x <= 0) & (max_x >= 0) & (min_y <= 0) &
+                (max_y >= 0);
+
+    // the sides in the order aabb_penetration_vector tries them, each taken
+    // only when strictly closer so ties resolve the same way. selects rather
+    // than branches so the lanes stay in one loop.
+    f32 dist = fabsf(min_x), rx = min_x, ry = 0;
+    bool is_closer = fabsf(max_x) < dist;
+    dist = is_closer ? fabsf(max_x) : dist;
+    rx = is_closer ? max_x : rx;
+    is_closer = fabsf(min_y) < dist;
+    dist = is_closer ? fabsf(min_y) : dist;
+    rx = is_closer ? 0 : rx;
+    ry = is_closer ? min_y : ry;
+    is_closer = fabsf(max_y) < dist;
+    rx = is_closer ? 0 : rx;
+    ry = is_closer ? max_y : ry;
+
+    out_x[lane] = rx;
+    out_y[lane] = ry;
+  }
+
+  memcpy(is_hit, hit, sizeof(hit));
+  memcpy(push_x, out_x, sizeof(out_x));
+  memcpy(push_y, out_y, sizeof(out_y));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../c-lib/dynlist.h"
+#include "../c-lib/types.h"
+#include "../math/math.h"
+
+// structure of arrays mirror of the fields the sweeps read from other bodies,
+// so testing candidates does not pull whole body records through the cache.
+// body_t stays the authoritative copy that game code reads and writes.
+typedef struct {
+  DYNLIST(f32) x;
+  DYNLIST(f32) y;
+  DYNLIST(f32) hx;
+  DYNLIST(f32) hy;
+  DYNLIST(u8) layer;
+  DYNLIST(u8) mask;
+} aabb_soa_t;
+
+void aabb_soa_init(aabb_soa_t* soa);
+void aabb_soa_destroy(aabb_soa_t* soa);
+void aabb_soa_resize(aabb_soa_t* soa, size_t count);
+
+M_INLINE void aabb_soa_set_position(aabb_soa_t* soa, size_t idx,
+                                    const vec2 position) {
+  soa->x[idx] = position[0];
+  soa->y[idx] = position[1];
+}
+
+M_INLINE void aabb_soa_set(aabb_soa_t* soa, size_t idx, const vec2 position,
+                           const vec2 half_size, u8 layer, u8 mask) {
+  aabb_soa_set_position(soa, idx, position);
+  soa->hx[idx] = half_size[0];
+  soa->hy[idx] = half_size[1];
+  soa->layer[idx] = layer;
+  soa->mask[idx] = mask;
+}
+
+// candidates packed into lanes so one moving box can be tested against all of
+// them in a single loop that the compiler can vectorize
+#define SWEEP_BATCH_WIDTH 8
+
+typedef struct {
+  f32 x[SWEEP_BATCH_WIDTH];
+  f32 y[SWEEP_BATCH_WIDTH];
+  f32 hx[SWEEP_BATCH_WIDTH];
+  f32 hy[SWEEP_BATCH_WIDTH];
+  u32 id[SWEEP_BATCH_WIDTH];
+  u32 count;
+} sweep_batch_t;
+
+M_INLINE void sweep_batch_push(sweep_batch_t* batch, const aabb_soa_t* soa,
+                               u32 id) {
+  u32 lane = batch->count++;
+  batch->x[lane] = soa->x[id];
+  batch->y[lane] = soa->y[id];
+  batch->hx[lane] = soa->hx[id];
+  batch->hy[lane] = soa->hy[id];
+  batch->id[lane] = id;
+}
+
+// batched ray_intersect_aabb: is_hit[lane] is set when the box at position
+// with half_size, moving by velocity, would hit the box in that lane. lanes at
+// or past batch->count are never hit.
+void sweep_batch_test(const sweep_batch_t* batch, const vec2 position,
+                      const vec2 half_size, const vec2 velocity,
+                      u32 is_hit[SWEEP_BATCH_WIDTH]);
+
+// batched physics_aabb_intersect_aabb and aabb_penetration_vector: is_hit[lane]
+// is set when the box at position with half_size overlaps or touches the box
+// in that lane, and push_x/push_y hold the shortest move out of it. lanes at
+// or past batch->count are never hit.
+void sweep_batch_penetration(const sweep_batch_t* batch, const vec2 position,
+                             const vec2 half_size,
+                             u32 is_hit[SWEEP_BATCH_WIDTH],
+                             f32 push_x[SWEEP_BATCH_WIDTH],
+                             f32 push_y[SWEEP_BATCH_WIDTH]);
@@ -0,0 +1,169 @@
+#include "profile.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "../c-lib/log.h"
+#include "../c-lib/math.h"
+#include "../c-lib/time.h"
+
+typedef struct {
+  const char* name;
+  u8 depth;
+  u32 calls;
+  f32 frame_ms[PROFILE_FRAME_COUNT]; // ring, indexed like frame_index
+} zone_t;
+
+// zones are never removed, the ids cached by PROFILE_SCOPE outlive
+// profile_destroy
+static zone_t zone_list[PROFILE_MAX_ZONES];
+static u16 zone_count;
+static u16 frame_zone = PROFILE_NO_ZONE;
+
+// the frame being recorded and the last complete one, swapped at its end
+static profile_record_t record_lists[2][PROFILE_MAX_RECORDS];
+static u16 record_counts[2];
+static u8 current;
+
+static u16 open_records[PROFILE_MAX_DEPTH];
+static u8 open_count;
+
+static u64 frame_start_ns;
+static u32 frame_index; // ring slot of the frame being recorded
+static u32 frames_recorded;
+
+// set on the thread inside a frame, so zones entered from the job workers are
+// skipped instead of racing the one recording
+static _Thread_local bool is_recording;
+
+void profile_init(void) {
+  for (u16 i = 0; i < zone_count; ++i) {
+    memset(zone_list[i].frame_ms, 0, sizeof(zone_list[i].frame_ms));
+    zone_list[i].calls = 0;
+  }
+  record_counts[0] = record_counts[1] = 0;
+  open_count = 0;
+  frame_index = 0;
+  frames_recorded = 0;
+  is_recording = false;
+  LOG("Profile system initialized");
+}
+
+void profile_destroy(void) {
+  is_recording = false;
+  LOG("Profile system deinitialized");
+}
+
+static u16 find_zone(const char* name, u8 depth) {
+  for (u16 i = 0; i < zone_count; ++i) {
+    if (strcmp(zone_list[i].name, name) == 0) {
+      return i;
+    }
+  }
+  if (zone_count == PROFILE_MAX_ZONES) {
+    WARN("Profile zone %s dropped, out of zones", name);
+    return PROFILE_NO_ZONE;
+  }
+  zone_list[zone_count] = (zone_t){.name = name, .depth = depth};
+  return zone_count++;
+}
+
+u16 profile_begin(u16* zone, const char* name) {
+  if (!is_recording) {
+    return PROFILE_NO_ZONE;
+  }
+  if (*zone == PROFILE_NO_ZONE) {
+    *zone = find_zone(name, open_count);
+  }
+  u16 count = record_counts[current];
+  if (*zone == PROFILE_NO_ZONE || count == PROFILE_MAX_RECORDS ||
+      open_count == PROFILE_MAX_DEPTH) {
+    return PROFILE_NO_ZONE;
+  }
+
+  record_lists[current][count] = (profile_record_t){
+      .begin_ns = time_ns() - frame_start_ns,
+      .zone = *zone,
+      .depth = open_count,
+  };
+  open_records[open_count++] = count;
+  record_counts[current] = count + 1;
+  return count;
+}
+
+void profile_end(u16 record) {
+  if (record == PROFILE_NO_ZONE || open_count == 0) {
+    return;
+  }
+  // zones close in the reverse order they opened, a zone left open closes
+  // along with the one around it
+  while (open_count > 0 && open_records[open_count - 1] >= record) {
+    u16 open = open_records[--open_count];
+    record_lists[current][open].end_ns = time_ns() - frame_start_ns;
+  }
+}
+
+void profile_frame_begin(void) {
+  is_recording = true;
+  open_count = 0;
+  record_counts[current] = 0;
+  frame_start_ns = time_ns();
+  if (frame_zone == PROFILE_NO_ZONE) {
+    frame_zone = find_zone("frame", 0);
+  }
+  profile_begin(&frame_zone, "frame");
+}
+
+void profile_frame_end(void) {
+  if (!is_recording) {
+    return;
+  }
+  profile_end(0);
+  is_recording = false;
+
+  for (u16 i = 0; i < zone_count; ++i) {
+    zone_list[i].frame_ms[frame_index] = 0.0f;
+    zone_list[i].calls = 0;
+  }
+  for (u16 i = 0; i < record_counts[current]; ++i) {
+    profile_record_t* record = &record_lists[current][i];
+    zone_t* zone = &zone_list[record->zone];
+    zone->frame_ms[frame_index] +=
+        (f32)(record->end_ns - record->begin_ns) / 1000000.0f;
+    ++zone->calls;
+  }
+
+  frame_index = (frame_index + 1) % PROFILE_FRAME_COUNT;
+  ++frames_recorded;
+  current = !current;
+}
+
+size_t profile_zone_count(void) { return zone_count; }
+
+profile_zone_stats_t profile_zone_stats(size_t zone) {
+  const zone_t* z = &zone_list[zone];
+  profile_zone_stats_t stats = {.name = z->name,
+                                .depth = z->depth,
+                                .calls = z->calls};
+  u32 count = min(frames_recorded, (u32)PROFILE_FRAME_COUNT);
+  if (count == 0) {
+    return stats;
+  }
+
+  u32 last = (frame_index + PROFILE_FRAME_COUNT - 1) % PROFILE_FRAME_COUNT;
+  stats.last = z->frame_ms[last];
+  stats.min = INFINITY;
+  for (u32 i = 0; i < count; ++i) {
+    f32 ms = z->frame_ms[i];
+    stats.min = min(stats.min, ms);
+    stats.max = max(stats.max, ms);
+    stats.avg += ms;
+  }
+  stats.avg /= count;
+  return stats;
+}
+
+const profile_record_t* profile_get_frame(size_t* count) {
+  *count = frames_recorded > 0 ? record_counts[!current] : 0;
+  return record_lists[!current];
+}
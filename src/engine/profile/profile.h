@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../c-lib/macros.h"
+#include "../c-lib/types.h"
+
+// frame profiler. code is split into named zones that nest, each timed with
+// time_ns. the records of the last PROFILE_FRAME_COUNT frames are kept in a
+// ring, fixed in size so profiling never allocates. zones are only recorded
+// between profile_frame_begin and profile_frame_end, and only from the thread
+// that runs the frame, outside of a frame they cost a branch.
+// defining PROFILE_DISABLE compiles the zones out.
+#define PROFILE_FRAME_COUNT 120
+#define PROFILE_MAX_ZONES 64
+#define PROFILE_MAX_DEPTH 16
+#define PROFILE_MAX_RECORDS 256 // per frame, later ones are dropped
+#define PROFILE_NO_ZONE 0xFFFF
+
+// one zone entered once during a frame, times from the start of the frame
+typedef struct {
+  u64 begin_ns, end_ns;
+  u16 zone;
+  u8 depth; // 0 for the frame itself
+} profile_record_t;
+
+// a zone over the frames in the ring, all in milliseconds. a frame where the
+// zone did not run counts as 0.
+typedef struct {
+  const char* name;
+  u8 depth; // where it was first entered
+  u32 calls; // times entered during the last frame
+  f32 last, min, avg, max;
+} profile_zone_stats_t;
+
+void profile_init(void);
+void profile_destroy(void);
+
+// the frame is a zone of its own that every other one nests in
+void profile_frame_begin(void);
+void profile_frame_end(void);
+
+// zone holds the id the name was given, looked up on the first call only.
+// returns the record to end, or PROFILE_NO_ZONE when nothing is recorded.
+u16 profile_begin(u16* zone, const char* name);
+void profile_end(u16 record);
+
+size_t profile_zone_count(void);
+profile_zone_stats_t profile_zone_stats(size_t zone);
+// records of the last complete frame in the order they began, valid until the
+// next profile_frame_end
+const profile_record_t* profile_get_frame(size_t* count);
+
+#ifndef PROFILE_DISABLE
+M_INLINE void profile_scope_end(u16* record) { profile_end(*record); }
+
+// times the rest of the enclosing block as zone _name, a string literal
+#define PROFILE_SCOPE(_name)                                                 \
+  static u16 _CONCAT(_profile_zone_, __LINE__) = PROFILE_NO_ZONE;            \
+  u16 _CONCAT(_profile_record_, __LINE__)                                    \
+      __attribute__((cleanup(profile_scope_end))) =                          \
+          profile_begin(&_CONCAT(_profile_zone_, __LINE__), _name)
+#else
+#define PROFILE_SCOPE(_name)
+#endif
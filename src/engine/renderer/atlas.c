@@ -0,0 +1,447 @@
+#include "atlas.h"
+
+#include "../c-lib/log.h"
+#include "../c-lib/math.h"
+#include "../c-lib/misc.h"
+#include "../io/io.h"
+#include "render_init.h"
+#include "stb_image.h"
+
+#include <glad/glad.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATLAS_FILE_MAGIC 0x534C5441 // "ATLS"
+#define ATLAS_FILE_VERSION 1
+
+// a run of the packed outline of a page, x to x + width is filled up to y.
+// the runs of a page are ordered by x and cover its whole width.
+typedef struct {
+  u32 x, y, width;
+} skyline_node_t;
+
+typedef struct {
+  u8* data;
+  u32 width, height;
+} atlas_image_t;
+
+typedef struct {
+  u32 entry;
+  u32 width, height; // with padding
+} pack_order_t;
+
+// written after the header for every entry, followed by its path
+typedef struct {
+  u32 x, y, width, height;
+  u32 page, page_x, page_y;
+  u32 path_length;
+} atlas_file_entry_t;
+
+typedef struct {
+  u32 magic, version;
+  u32 page_size, page_count, entry_count;
+} atlas_file_header_t;
+
+void atlas_init(atlas_t* atlas, u32 page_size) {
+  *atlas = (atlas_t){
+      .page_size = page_size,
+      .entry_list = dynlist_create(atlas_entry_t),
+      .pixel_list = dynlist_create(u8),
+  };
+}
+
+void atlas_destroy(atlas_t* atlas) {
+  dynlist_destroy(atlas->entry_list);
+  dynlist_destroy(atlas->pixel_list);
+}
+
+void atlas_add(atlas_t* atlas, sprite_sheet_t* sprite_sheet, const char* path,
+               f32 cell_width, f32 cell_height) {
+  // the size is only known once the image is loaded
+  atlas_add_rect(atlas, sprite_sheet, path, 0, 0, 0, 0, cell_width,
+                 cell_height);
+}
+
+void atlas_add_rect(atlas_t* atlas, sprite_sheet_t* sprite_sheet,
+                    const char* path, u32 x, u32 y, u32 width, u32 height,
+                    f32 cell_width, f32 cell_height) {
+  *dynlist_append(atlas->entry_list) = (atlas_entry_t){
+      .path = path,
+      .x = x,
+      .y = y,
+      .width = width,
+      .height = height,
+      .cell_width = cell_width,
+      .cell_height = cell_height,
+      .sprite_sheet = sprite_sheet,
+  };
+}
+
+// the lowest a width wide rect can be placed with its left edge at node i, or
+// false when it runs past the page
+static bool skyline_fit(DYNLIST(skyline_node_t) skyline, size_t i, u32 width,
+                        u32 height, u32 page_size, u32* y) {
+  if (skyline[i].x + width > page_size) {
+    return false;
+  }
+  u32 top = 0;
+  u32 remaining = width;
+  for (size_t j = i; remaining > 0; ++j) {
+    top = max(top, skyline[j].y);
+    if (top + height > page_size) {
+      return false;
+    }
+    remaining -= min(remaining, skyline[j].width);
+  }
+  *y = top;
+  return true;
+}
+
+// raises the outline over the rect placed on node i
+static void skyline_add(DYNLIST(skyline_node_t) * skyline, size_t i, u32 width,
+                        u32 height, u32 y) {
+  u32 x = (*skyline)[i].x;
+  *dynlist_insert(*skyline, i) =
+      (skyline_node_t){.x = x, .y = y + height, .width = width};
+
+  // the nodes under the rect shrink or go
+  u32 end = x + width;
+  while (i + 1 < dynlist_size(*skyline) && (*skyline)[i + 1].x < end) {
+    skyline_node_t* node = &(*skyline)[i + 1];
+    u32 covered = end - node->x;
+    if (node->width > covered) {
+      node->x += covered;
+      node->width -= covered;
+      break;
+    }
+    dynlist_remove(*skyline, i + 1);
+  }
+
+  for (size_t j = 0; j + 1 < dynlist_size(*skyline);) {
+    if ((*skyline)[j].y == (*skyline)[j + 1].y) {
+      (*skyline)[j].width += (*skyline)[j + 1].width;
+      dynlist_remove(*skyline, j + 1);
+    } else {
+      ++j;
+    }
+  }
+}
+
+// bottom left placement, the node the rect ends lowest on and the narrowest
+// of those, which leaves the least space under it unused
+static bool skyline_find(DYNLIST(skyline_node_t) skyline, u32 width,
+                         u32 height, u32 page_size, size_t* node, u32* y) {
+  bool is_found = false;
+  u32 best_top = 0, best_width = 0;
+  for (size_t i = 0; i < dynlist_size(skyline); ++i) {
+    u32 fit_y;
+    if (!skyline_fit(skyline, i, width, height, page_size, &fit_y)) {
+      continue;
+    }
+    u32 top = fit_y + height;
+    if (!is_found || top < best_top ||
+        (top == best_top && skyline[i].width < best_width)) {
+      is_found = true;
+      best_top = top;
+      best_width = skyline[i].width;
+      *node = i;
+      *y = fit_y;
+    }
+  }
+  return is_found;
+}
+
+static int compare_pack_order(const void* a, const void* b) {
+  const pack_order_t* pa = a;
+  const pack_order_t* pb = b;
+  if (pa->height != pb->height) {
+    return pa->height < pb->height ? 1 : -1;
+  }
+  if (pa->width != pb->width) {
+    return pa->width < pb->width ? 1 : -1;
+  }
+  return pa->entry < pb->entry ? -1 : 1; // stable, for the same layout
+}
+
+// copies the entry's rect of the image into its page along with the padding
+// around it, which repeats the rect's edge pixels
+static void copy_to_page(atlas_t* atlas, const atlas_entry_t* entry,
+                         const atlas_image_t* image) {
+  u32* page = (u32*)&atlas->pixel_list[(size_t)entry->page * atlas->page_size *
+                                       atlas->page_size * 4];
+  const u32* pixels = (const u32*)image->data;
+  // the image is stored bottom row first, the rect is measured from its top
+  u32 bottom = image->height - entry->y - entry->height;
+
+  i32 pad = ATLAS_PADDING;
+  for (i32 y = -pad; y < (i32)entry->height + pad; ++y) {
+    u32 src_y = bottom + (u32)clamp(y, 0, (i32)entry->height - 1);
+    u32* dst = &page[(size_t)(entry->page_y + y) * atlas->page_size];
+    for (i32 x = -pad; x < (i32)entry->width + pad; ++x) {
+      u32 src_x = entry->x + (u32)clamp(x, 0, (i32)entry->width - 1);
+      dst[entry->page_x + x] = pixels[(size_t)src_y * image->width + src_x];
+    }
+  }
+}
+
+void atlas_pack(atlas_t* atlas) {
+  size_t count = dynlist_size(atlas->entry_list);
+  u32 page_size = atlas->page_size;
+
+  // an image several entries take rects of is loaded once
+  DYNLIST(atlas_image_t) image_list = dynlist_create(atlas_image_t, count);
+  DYNLIST(u32) entry_images = dynlist_create(u32, count);
+  stbi_set_flip_vertically_on_load(1);
+  for (size_t i = 0; i < count; ++i) {
+    atlas_entry_t* entry = &atlas->entry_list[i];
+    size_t image = 0;
+    while (image < i &&
+           strcmp(atlas->entry_list[image].path, entry->path) != 0) {
+      ++image;
+    }
+    if (image == i) {
+      int width, height, channel_count;
+      // force loading the image with 4 channels (RGBA)
+      u8* data = stbi_load(entry->path, &width, &height, &channel_count, 4);
+      ASSERT(data, "failed to load image from stb image: %s", entry->path);
+      *dynlist_append(image_list) = (atlas_image_t){
+          .data = data, .width = (u32)width, .height = (u32)height};
+      image = dynlist_size(image_list) - 1;
+    } else {
+      image = entry_images[image];
+    }
+    *dynlist_append(entry_images) = image;
+
+    atlas_image_t* loaded = &image_list[image];
+    if (entry->width == 0) {
+      entry->width = loaded->width;
+      entry->height = loaded->height;
+    }
+    ASSERT(entry->width > 0 && entry->height > 0 &&
+               entry->x + entry->width <= loaded->width &&
+               entry->y + entry->height <= loaded->height,
+           "rect %u,%u %ux%u is outside of %s", entry->x, entry->y,
+           entry->width, entry->height, entry->path);
+  }
+
+  // tallest first, the skyline stays flat for longest that way
+  DYNLIST(pack_order_t) order = dynlist_create(pack_order_t, count);
+  for (size_t i = 0; i < count; ++i) {
+    atlas_entry_t* entry = &atlas->entry_list[i];
+    *dynlist_append(order) = (pack_order_t){
+        .entry = i,
+        .width = entry->width + 2 * ATLAS_PADDING,
+        .height = entry->height + 2 * ATLAS_PADDING,
+    };
+  }
+  qsort(order, count, sizeof(pack_order_t), compare_pack_order);
+
+  DYNLIST(skyline_node_t) skylines[ATLAS_MAX_PAGES] = {0};
+  atlas->page_count = 0;
+  dynlist_each(order, rect) {
+    atlas_entry_t* entry = &atlas->entry_list[rect->entry];
+    ASSERT(rect->width <= page_size && rect->height <= page_size,
+           "%s does not fit a %u page", entry->path, page_size);
+
+    // the first page it fits on, or a new one
+    size_t node;
+    u32 y;
+    u32 page = 0;
+    while (page < atlas->page_count &&
+           !skyline_find(skylines[page], rect->width, rect->height, page_size,
+                         &node, &y)) {
+      ++page;
+    }
+    if (page == atlas->page_count) {
+      ASSERT(page < ATLAS_MAX_PAGES, "atlas is out of pages");
+      skylines[page] = dynlist_create(skyline_node_t);
+      *dynlist_append(skylines[page]) =
+          (skyline_node_t){.x = 0, .y = 0, .width = page_size};
+      ++atlas->page_count;
+      node = 0;
+      y = 0;
+    }
+
+    entry->page = page;
+    entry->page_x = skylines[page][node].x + ATLAS_PADDING;
+    entry->page_y = y + ATLAS_PADDING;
+    skyline_add(&skylines[page], node, rect->width, rect->height, y);
+  }
+
+  dynlist_resize(atlas->pixel_list,
+                 (size_t)atlas->page_count * page_size * page_size * 4);
+  memset(atlas->pixel_list, 0, dynlist_size(atlas->pixel_list));
+  for (size_t i = 0; i < count; ++i) {
+    copy_to_page(atlas, &atlas->entry_list[i], &image_list[entry_images[i]]);
+  }
+
+  for (u32 i = 0; i < atlas->page_count; ++i) {
+    dynlist_destroy(skylines[i]);
+  }
+  dynlist_each(image_list, image) { stbi_image_free(image->data); }
+  dynlist_destroy(order);
+  dynlist_destroy(entry_images);
+  dynlist_destroy(image_list);
+  LOG("Packed %zu images into %u atlas pages", count, atlas->page_count);
+}
+
+// grows the buffer by size bytes, returns where they start
+static void* buffer_reserve(DYNLIST(u8) * buffer, size_t size) {
+  size_t offset = dynlist_size(*buffer);
+  dynlist_resize(*buffer, offset + size);
+  return &(*buffer)[offset];
+}
+
+int atlas_write(atlas_t* atlas, const char* path) {
+  DYNLIST(u8) buffer = dynlist_create(u8);
+
+  atlas_file_header_t header = {
+      .magic = ATLAS_FILE_MAGIC,
+      .version = ATLAS_FILE_VERSION,
+      .page_size = atlas->page_size,
+      .page_count = atlas->page_count,
+      .entry_count = dynlist_size(atlas->entry_list),
+  };
+  memcpy(buffer_reserve(&buffer, sizeof(header)), &header, sizeof(header));
+  dynlist_each(atlas->entry_list, entry) {
+    atlas_file_entry_t file_entry = {
+        .x = entry->x,
+        .y = entry->y,
+        .width = entry->width,
+        .height = entry->height,
+        .page = entry->page,
+        .page_x = entry->page_x,
+        .page_y = entry->page_y,
+        .path_length = strlen(entry->path),
+    };
+    memcpy(buffer_reserve(&buffer, sizeof(file_entry)), &file_entry,
+           sizeof(file_entry));
+    memcpy(buffer_reserve(&buffer, file_entry.path_length), entry->path,
+           file_entry.path_length);
+  }
+  size_t pixels = dynlist_size(atlas->pixel_list);
+  memcpy(buffer_reserve(&buffer, pixels), atlas->pixel_list, pixels);
+
+  int result = io_file_write(buffer, dynlist_size(buffer), path);
+  dynlist_destroy(buffer);
+  return result;
+}
+
+// checks the file against the entries first, the atlas is left as it was
+// unless all of them match
+static bool read_file(atlas_t* atlas, const char* data, size_t len) {
+  size_t count = dynlist_size(atlas->entry_list);
+  atlas_file_header_t header;
+  if (len < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != ATLAS_FILE_MAGIC ||
+      header.version != ATLAS_FILE_VERSION ||
+      header.page_size != atlas->page_size || header.entry_count != count ||
+      header.page_count > ATLAS_MAX_PAGES) {
+    return false;
+  }
+
+  size_t offset = sizeof(header);
+  size_t entries = offset;
+  for (size_t i = 0; i < count; ++i) {
+    atlas_entry_t* entry = &atlas->entry_list[i];
+    atlas_file_entry_t file_entry;
+    if (len - offset < sizeof(file_entry)) {
+      return false;
+    }
+    memcpy(&file_entry, data + offset, sizeof(file_entry));
+    offset += sizeof(file_entry);
+
+    size_t path_length = strlen(entry->path);
+    if (file_entry.path_length != path_length || len - offset < path_length ||
+        memcmp(data + offset, entry->path, path_length) != 0) {
+      return false;
+    }
+    offset += path_length;
+    // a whole image takes whatever size it was packed with
+    if (entry->width != 0 &&
+        (file_entry.x != entry->x || file_entry.y != entry->y ||
+         file_entry.width != entry->width ||
+         file_entry.height != entry->height)) {
+      return false;
+    }
+    // and it has to lie on one of the pages, or the sheet would sample
+    // outside the texture array
+    if (file_entry.page >= header.page_count ||
+        (u64)file_entry.page_x + file_entry.width > header.page_size ||
+        (u64)file_entry.page_y + file_entry.height > header.page_size) {
+      return false;
+    }
+  }
+  size_t pixels =
+      (size_t)header.page_count * header.page_size * header.page_size * 4;
+  if (len - offset != pixels) {
+    return false;
+  }
+
+  offset = entries;
+  dynlist_each(atlas->entry_list, entry) {
+    atlas_file_entry_t file_entry;
+    memcpy(&file_entry, data + offset, sizeof(file_entry));
+    offset += sizeof(file_entry) + file_entry.path_length;
+    entry->x = file_entry.x;
+    entry->y = file_entry.y;
+    entry->width = file_entry.width;
+    entry->height = file_entry.height;
+    entry->page = file_entry.page;
+    entry->page_x = file_entry.page_x;
+    entry->page_y = file_entry.page_y;
+  }
+  atlas->page_count = header.page_count;
+  dynlist_resize(atlas->pixel_list, pixels);
+  memcpy(atlas->pixel_list, data + offset, pixels);
+  return true;
+}
+
+bool atlas_read(atlas_t* atlas, const char* path) {
+  file_t file = io_file_read(path);
+  if (!file.is_valid) {
+    return false;
+  }
+  bool is_valid = read_file(atlas, file.data, file.len);
+  if (!is_valid) {
+    WARN("%s is not an atlas of these images", path);
+  }
+  free(file.data);
+  return is_valid;
+}
+
+void atlas_upload(atlas_t* atlas) {
+  ASSERT(atlas->page_count > 0, "atlas was neither packed nor read");
+  u32 page_size = atlas->page_size;
+  render_init_texture_array(&atlas->texture_array, page_size, page_size,
+                            atlas->page_count);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture_array);
+  for (u32 i = 0; i < atlas->page_count; ++i) {
+    glTexSubImage3D(
+        GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, page_size, page_size, 1, GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        &atlas->pixel_list[(size_t)i * page_size * page_size * 4]);
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  f32 size = (f32)page_size;
+  dynlist_each(atlas->entry_list, entry) {
+    *entry->sprite_sheet = (sprite_sheet_t){
+        .width = (f32)entry->width,
+        .height = (f32)entry->height,
+        .cell_width = entry->cell_width,
+        .cell_height = entry->cell_height,
+        .texture_id = atlas->texture_array,
+        .layer = entry->page,
+        .is_array_layer = true,
+        .uv_rect = {entry->page_x / size, entry->page_y / size,
+                    entry->width / size, entry->height / size},
+    };
+  }
+  LOG("Uploaded %u atlas pages of %u", atlas->page_count, page_size);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../c-lib/dynlist.h"
+#include "../c-lib/types.h"
+#include "render.h"
+
+// texture atlas. images, or parts of them, are packed into square pages that
+// become the layers of one texture array, so every sprite sheet in an atlas is
+// drawn by the sprite batch in a single call. the sheets keep their own size
+// and cells, only their uv_rect points at where they ended up.
+//
+// images are either packed at startup:
+//   atlas_init, atlas_add..., atlas_pack, atlas_upload, atlas_destroy
+// or ahead of time, by a tool that packs and calls atlas_write, and the game
+// then calls atlas_read instead of atlas_pack with the same adds. reading
+// skips decoding and packing, but the file has to be written again whenever
+// the images change.
+#define ATLAS_MAX_PAGES 16
+// pixels around every image, its edges repeated, so sampling at the border of
+// a cell does not pick up the image next to it
+#define ATLAS_PADDING 1
+
+typedef struct {
+  const char* path; // not copied, it has to outlive the atlas
+  // the part of the image that is packed in pixels from its top left, the
+  // whole image when added with atlas_add
+  u32 x, y, width, height;
+  f32 cell_width, cell_height;
+  sprite_sheet_t* sprite_sheet;
+  // where it was packed, in pixels from the bottom left of the page
+  u32 page, page_x, page_y;
+} atlas_entry_t;
+
+typedef struct {
+  u32 page_size;
+  u32 page_count;
+  u32 texture_array;
+  DYNLIST(atlas_entry_t) entry_list;
+  // rgba of every page one after the other, bottom row first like the images
+  // stb image loads
+  DYNLIST(u8) pixel_list;
+} atlas_t;
+
+void atlas_init(atlas_t* atlas, u32 page_size);
+// frees the images, the texture array and the sheets drawn from it remain
+void atlas_destroy(atlas_t* atlas);
+
+// the sheet is filled in by atlas_upload, until then it cannot be drawn
+void atlas_add(atlas_t* atlas, sprite_sheet_t* sprite_sheet, const char* path,
+               f32 cell_width, f32 cell_height);
+void atlas_add_rect(atlas_t* atlas, sprite_sheet_t* sprite_sheet,
+                    const char* path, u32 x, u32 y, u32 width, u32 height,
+                    f32 cell_width, f32 cell_height);
+
+// loads every image added and packs them into as few pages as they fit in
+void atlas_pack(atlas_t* atlas);
+// the pages and where each image went, returns 0 on success like
+// io_file_write
+int atlas_write(atlas_t* atlas, const char* path);
+// instead of packing, false when the file is missing or was written for
+// other images or another page size
+bool atlas_read(atlas_t* atlas, const char* path);
+
+// creates the texture array from the pages and points the sheets at it
+void atlas_upload(atlas_t* atlas);
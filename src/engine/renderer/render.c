@@ -1,7 +1,11 @@
 #include "render.h"
 
+#include <stdlib.h>
+
 #include "../c-lib/dynlist.h"
+#include "../c-lib/math.h"
 #include "../c-lib/misc.h"
+#include "../profile/profile.h"
 #include "../state.h"
 #include "render_init.h"
 
@@ -17,16 +21,46 @@ static f32 render_scale;
 static vec4 background_color;
 
 // ---- 2d rendering state ----
-static u32 texture_slots[8] = {0}; // index zero reserved for default WHITE
-static u32 white_texture_id;       // index zero of texture_slots
+// texture units the sprite batch samples from, assigned again for every draw
+static u32 texture_slots[MAX_TEXTURE_SLOTS] = {0}; // zero is the default WHITE
+static u32 texture_slot_count; // usable slots, see render_init_texture_slots
+static u32 white_texture_id;   // index zero of texture_slots
+static bool is_sorting_textures = false; // see render_get_sort_by_texture
+// marks the quads of texture array layers in sprite_texture_list, their
+// vertices hold the layer instead of a slot
+#define ARRAY_TEXTURE_BIT 0x80000000u
 
 static u32 shader_2d_default, shader_2d_sprite_batch, shader_2d_line_batch;
+static u32 shader_2d_sprite_array_batch;
 static u32 vao_quad, vbo_quad, ebo_quad;
 static u32 vao_sprite_batch, vbo_sprite_batch, ebo_sprite_batch;
 static u32 vao_line, vbo_line;
 static u32 vao_line_batch, vbo_line_batch;
-static DYNLIST(batch_sprite_vertex_t) sprite_batch_list;
-static DYNLIST(batch_line_vertex_t) line_batch_list;
+
+// a buffer the batches are written into through glMapBufferRange. every batch
+// maps the range after the previous one unsynchronized, so the driver never
+// waits for draws still reading the buffer, which is safe as nothing is ever
+// written over. once it is used up the buffer is orphaned with glBufferData,
+// the draws in flight keep the old storage and the batches get a new one.
+typedef struct {
+  u32 buffer;
+  size_t size;   // in bytes
+  size_t offset; // where the next range is mapped
+  void* data;    // the mapped range, NULL when unmapped
+} stream_buffer_t;
+
+// the batches are written straight into the mapped ranges, there is no copy
+// of them kept. sprite_texture_list has the texture id of every quad.
+static stream_buffer_t sprite_stream, sprite_index_stream, line_stream;
+static DYNLIST(u32) sprite_texture_list;
+static size_t line_vertex_count;
+// where the last sprite batch unmapped, for its draws
+static GLint sprite_base_vertex;
+static size_t sprite_index_offset;
+// scratch for ordering a batch by texture
+static DYNLIST(u32) sprite_order_list;
+static DYNLIST(u32) sprite_sorted_texture_list;
+static render_stats_t stats, frame_stats; // last frame and the current one
 
 // ---- 3d rendering state ----
 static u32 shader_3d;
@@ -46,32 +80,51 @@ void render_init(u32 width, u32 height, f32 scale, vec4 bg_color) {
   render_init_line(&vao_line, &vbo_line);
   render_init_color_texture(&texture_slots[0]);
   white_texture_id = texture_slots[0];
+  texture_slot_count = render_init_texture_slots();
   render_init_batch_lines(&vao_line_batch, &vbo_line_batch);
+  u32 ebo_sprite_sorted;
   render_init_batch_texture_quads(&vao_sprite_batch, &vbo_sprite_batch,
-                                  &ebo_sprite_batch);
+                                  &ebo_sprite_batch, &ebo_sprite_sorted);
+  sprite_stream = (stream_buffer_t){
+      .buffer = vbo_sprite_batch,
+      .size = STREAM_BUFFER_BATCHES * MAX_BATCH_VERTICES *
+              sizeof(batch_sprite_vertex_t),
+  };
+  sprite_index_stream = (stream_buffer_t){
+      .buffer = ebo_sprite_sorted,
+      .size = STREAM_BUFFER_BATCHES * MAX_BATCH_ELEMENTS * sizeof(u32),
+  };
+  line_stream = (stream_buffer_t){
+      .buffer = vbo_line_batch,
+      .size = STREAM_BUFFER_BATCHES * MAX_BATCH_LINE_VERTICES *
+              sizeof(batch_line_vertex_t),
+  };
 
   // ---- initialize 3d components ----
   render_init_cube(&vao_cube, &vbo_cube, &ebo_cube);
 
   // ---- initialize all shaders ----
   render_init_shaders(&shader_2d_default, &shader_2d_sprite_batch,
-                      &shader_2d_line_batch, &shader_3d, render_width,
-                      render_height);
+                      &shader_2d_sprite_array_batch, &shader_2d_line_batch,
+                      &shader_3d, render_width, render_height,
+                      texture_slot_count);
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   stbi_set_flip_vertically_on_load(1);
 
-  sprite_batch_list = dynlist_create(batch_sprite_vertex_t, 8);
-  line_batch_list = dynlist_create(batch_line_vertex_t, 8);
+  sprite_texture_list = dynlist_create(u32, 8);
+  sprite_order_list = dynlist_create(u32, 8);
+  sprite_sorted_texture_list = dynlist_create(u32, 8);
 
   LOG("Renderer system initialized");
 }
 
 void render_destroy(void) {
-  dynlist_destroy(sprite_batch_list);
-  dynlist_destroy(line_batch_list);
+  dynlist_destroy(sprite_texture_list);
+  dynlist_destroy(sprite_order_list);
+  dynlist_destroy(sprite_sorted_texture_list);
   // TODO destroy all opengl data
   glfwTerminate();
   LOG("Renderer system deinitialized");
@@ -79,16 +132,27 @@ void render_destroy(void) {
 
 f32 render_get_render_scale(void) { return render_scale; }
 fv2 render_get_render_size(void) { return (fv2){render_width, render_height}; }
+render_stats_t render_get_stats(void) { return stats; }
+bool* render_get_sort_by_texture(void) { return &is_sorting_textures; }
+u32 render_get_texture_slot_count(void) { return texture_slot_count; }
 
 void render_begin(void) {
+  PROFILE_SCOPE("render begin");
   glClearColor(background_color[0], background_color[1], background_color[2],
                background_color[3]);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  dynlist_clear(sprite_batch_list); // clear the list each frame
-  dynlist_clear(line_batch_list);
+  // drop what was not drawn, a range still mapped is written over from its
+  // start
+  dynlist_clear(sprite_texture_list);
+  line_vertex_count = 0;
+  frame_stats = (render_stats_t){0};
 }
 
-void render_end(void) { glfwSwapBuffers(state.window); }
+void render_end(void) {
+  PROFILE_SCOPE("swap buffers");
+  glfwSwapBuffers(state.window);
+  stats = frame_stats;
+}
 
 void render_begin_2d(void) {
   // 2d shaders should already have the orthographic projection matrix set from
@@ -96,50 +160,265 @@ void render_begin_2d(void) {
   glDisable(GL_DEPTH_TEST);
 }
 
-void render_sprite_batch(void) {
-  size_t num_vertices = dynlist_size(sprite_batch_list);
-  if (num_vertices == 0) return;
+// maps size bytes for a batch to be written into
+static void* stream_buffer_map(stream_buffer_t* stream, size_t size) {
+  ASSERT(stream->data == NULL, "stream buffer %u is already mapped",
+         stream->buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+  if (stream->offset + size > stream->size) {
+    glBufferData(GL_COPY_WRITE_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+    stream->offset = 0;
+  }
+  stream->data = glMapBufferRange(
+      GL_COPY_WRITE_BUFFER, stream->offset, size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+  ASSERT(stream->data, "failed to map stream buffer %u", stream->buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return stream->data;
+}
+
+// unmaps the range once size bytes of it were written, returns the offset in
+// the buffer the draws read them from
+static size_t stream_buffer_unmap(stream_buffer_t* stream, size_t size) {
+  glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+  // only what was written is sent, not the whole range
+  glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, size);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  size_t offset = stream->offset;
+  stream->offset += size;
+  stream->data = NULL;
+  return offset;
+}
 
-  // update the vbo buffer dynamically
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_sprite_batch);
-  glBufferSubData(GL_ARRAY_BUFFER, 0,
-                  num_vertices * sizeof(batch_sprite_vertex_t),
-                  sprite_batch_list);
-
-  ASSERT(texture_slots[0] == white_texture_id,
-         "texture slot 0 should be white_texture_id (%d), but is %d",
-         white_texture_id, texture_slots[0]);
-  for (u32 i = 0; i < 8; ++i) {
-    // fragment shader texture i = our texture id at slot[i]
-    glActiveTexture(GL_TEXTURE0 + i);
-    u32 id = texture_slots[i];
-    /* Use a valid defined texture id to avoid the following warning:
-     * UNSUPPORTED (log once): POSSIBLE ISSUE: unit 1 GLD_TEXTURE_INDEX_2D is
-     * unloadable and bound to sampler type (Float) - using zero texture because
-     * texture unloadable.
-     */
-    glBindTexture(GL_TEXTURE_2D, id == 0 ? white_texture_id : id);
+// returns the index of the texture slot associated to texture_id (-1 if full)
+static i32 set_texture_slot(u32 texture_id) {
+  // the zero'th index is reserved for the default color texture
+  if (texture_id == white_texture_id) {
+    return 0;
+  }
+  for (u32 i = 1; i < texture_slot_count; ++i) {
+    if (texture_slots[i] == texture_id) {
+      return i;
+    }
+    if (texture_slots[i] == 0) {
+      texture_slots[i] = texture_id;
+      return i;
+    }
   }
 
-  glUseProgram(shader_2d_sprite_batch);
+  // returns -1 on failure
+  return -1;
+}
+
+static void clear_texture_slots(void) {
+  for (u32 i = 1; i < texture_slot_count; ++i) {
+    texture_slots[i] = 0;
+  }
+}
+
+// gives the quads from start on the slot of their texture, in vertices when
+// not NULL. order maps the position a quad is drawn at to the quad, NULL for
+// the order submitted. returns where the slots ran out or a texture array
+// quad came up.
+static size_t assign_texture_slots(batch_sprite_vertex_t* vertices,
+                                   const u32* order, const u32* textures,
+                                   size_t start, size_t count) {
+  u32 last_texture = white_texture_id;
+  i32 slot = 0;
+  for (size_t i = start; i < count; ++i) {
+    if (textures[i] & ARRAY_TEXTURE_BIT) {
+      return i;
+    }
+    if (textures[i] != last_texture) {
+      slot = set_texture_slot(textures[i]);
+      if (slot == -1) {
+        return i;
+      }
+      last_texture = textures[i];
+    }
+    if (vertices != NULL) {
+      u32 quad = order != NULL ? order[i] : i;
+      for (u32 j = 0; j < 4; ++j) {
+        vertices[quad * 4 + j].texture_slot_index = slot;
+      }
+    }
+  }
+  return count;
+}
+
+// draws the quads at start in the order of the last batch unmapped.
+// array_texture is the texture array they sample, 0 when they sample the
+// texture slots.
+static void draw_sprite_quads(size_t start, size_t quad_count,
+                              const u32* order, u32 array_texture) {
+  ++frame_stats.sprite_flushes;
   glBindVertexArray(vao_sprite_batch);
-  // the amount of quads we are drawing is count / 4, with six indices per quad
-  // so we draw all of the required indices that were set up in the batch init
-  glDrawElements(GL_TRIANGLES, (num_vertices >> 2) * 6, GL_UNSIGNED_INT, NULL);
+
+  // six indices per quad either way, a sorted batch has its own
+  size_t index_offset = start * 6 * sizeof(u32);
+  if (order != NULL) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sprite_index_stream.buffer);
+    index_offset += sprite_index_offset;
+  } else {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_sprite_batch);
+  }
+
+  if (array_texture != 0) {
+    // a single texture whatever the number of sheets, no slots to fill
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array_texture);
+    glUseProgram(shader_2d_sprite_array_batch);
+  } else {
+    ASSERT(texture_slots[0] == white_texture_id,
+           "texture slot 0 should be white_texture_id (%d), but is %d",
+           white_texture_id, texture_slots[0]);
+    for (u32 i = 0; i < texture_slot_count; ++i) {
+      // fragment shader texture i = our texture id at slot[i]
+      glActiveTexture(GL_TEXTURE0 + i);
+      u32 id = texture_slots[i];
+      /* Use a valid defined texture id to avoid the following warning:
+       * UNSUPPORTED (log once): POSSIBLE ISSUE: unit 1 GLD_TEXTURE_INDEX_2D is
+       * unloadable and bound to sampler type (Float) - using zero texture
+       * because texture unloadable.
+       */
+      glBindTexture(GL_TEXTURE_2D, id == 0 ? white_texture_id : id);
+    }
+    glUseProgram(shader_2d_sprite_batch);
+  }
+
+  // the indices count from the start of the batch, the base vertex is where
+  // the batch was written in the buffer
+  glDrawElementsBaseVertex(GL_TRIANGLES, quad_count * 6, GL_UNSIGNED_INT,
+                           (void*)index_offset, sprite_base_vertex);
 }
 
-void render_aabb_line_batch(void) {
-  size_t num_vertices = dynlist_size(line_batch_list);
+static int cmp_quad_texture(const void* a, const void* b) {
+  u32 qa = *(const u32*)a, qb = *(const u32*)b;
+  u32 ta = sprite_texture_list[qa], tb = sprite_texture_list[qb];
+  if (ta != tb) {
+    return ta < tb ? -1 : 1;
+  }
+  // quads of one texture keep the order they were submitted in
+  return qa < qb ? -1 : qa > qb;
+}
+
+// orders the quads of the batch by texture into sprite_order_list, so every
+// texture is drawn in one run. the vertices stay where they were written.
+static void sort_sprite_batch(void) {
+  size_t quad_count = dynlist_size(sprite_texture_list);
+  dynlist_resize(sprite_order_list, quad_count);
+  for (size_t i = 0; i < quad_count; ++i) {
+    sprite_order_list[i] = i;
+  }
+  qsort(sprite_order_list, quad_count, sizeof(u32), cmp_quad_texture);
+
+  dynlist_resize(sprite_sorted_texture_list, quad_count);
+  for (size_t i = 0; i < quad_count; ++i) {
+    sprite_sorted_texture_list[i] = sprite_texture_list[sprite_order_list[i]];
+  }
+}
+
+// goes over the batch a run at a time: texture array quads of the same array
+// go in one run, the others in runs that use up the texture slots. the slots
+// are written into vertices when not NULL, and the runs drawn when
+// is_drawing, which assigns the same slots over again. returns the run count.
+static u32 draw_sprite_runs(batch_sprite_vertex_t* vertices, const u32* order,
+                            const u32* textures, size_t count,
+                            bool is_drawing) {
+  u32 run_count = 0;
+  size_t start = 0;
+  while (start < count) {
+    size_t end = start + 1;
+    u32 array_texture = 0;
+    if (textures[start] & ARRAY_TEXTURE_BIT) {
+      // the layers were set when the quads were added
+      while (end < count && textures[end] == textures[start]) {
+        ++end;
+      }
+      array_texture = textures[start] & ~ARRAY_TEXTURE_BIT;
+    } else {
+      clear_texture_slots();
+      end = assign_texture_slots(vertices, order, textures, start, count);
+    }
+    if (is_drawing) {
+      draw_sprite_quads(start, end - start, order, array_texture);
+    }
+    ++run_count;
+    start = end;
+  }
+  return run_count;
+}
+
+// draws the batch in as few calls as the textures allow. when it would take
+// more than one and sorting was turned on, the batch is ordered by texture
+// first, which changes which sprite is drawn over which where sprites of
+// different textures overlap.
+static void flush_sprite_batch(void) {
+  size_t quad_count = dynlist_size(sprite_texture_list);
+  if (quad_count == 0) return;
+
+  const u32* order = NULL;
+  const u32* textures = sprite_texture_list;
+  if (is_sorting_textures &&
+      draw_sprite_runs(NULL, NULL, textures, quad_count, false) > 1) {
+    sort_sprite_batch();
+    order = sprite_order_list;
+    textures = sprite_sorted_texture_list;
+  }
+
+  // the slots go in while the vertices are still mapped, a buffer cannot be
+  // drawn from until it is unmapped
+  draw_sprite_runs(sprite_stream.data, order, textures, quad_count, false);
+  size_t offset = stream_buffer_unmap(
+      &sprite_stream, quad_count * 4 * sizeof(batch_sprite_vertex_t));
+  sprite_base_vertex = offset / sizeof(batch_sprite_vertex_t);
+
+  if (order != NULL) {
+    u32* indices =
+        stream_buffer_map(&sprite_index_stream, quad_count * 6 * sizeof(u32));
+    for (size_t i = 0; i < quad_count; ++i) {
+      u32 vertex = order[i] * 4;
+      // same corners as the ebo, see render_init_batch_texture_quads
+      indices[i * 6 + 0] = vertex + 0;
+      indices[i * 6 + 1] = vertex + 1;
+      indices[i * 6 + 2] = vertex + 2;
+      indices[i * 6 + 3] = vertex + 2;
+      indices[i * 6 + 4] = vertex + 3;
+      indices[i * 6 + 5] = vertex + 0;
+    }
+    sprite_index_offset = stream_buffer_unmap(&sprite_index_stream,
+                                              quad_count * 6 * sizeof(u32));
+  }
+  draw_sprite_runs(NULL, order, textures, quad_count, true);
+
+  dynlist_clear(sprite_texture_list);
+}
+
+void render_sprite_batch(void) {
+  PROFILE_SCOPE("sprite batch");
+  flush_sprite_batch();
+}
+
+static void flush_line_batch(void) {
+  size_t num_vertices = line_vertex_count;
   if (num_vertices == 0) return;
+  ++frame_stats.line_flushes;
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_line_batch);
-  glBufferSubData(GL_ARRAY_BUFFER, 0,
-                  num_vertices * sizeof(batch_line_vertex_t), line_batch_list);
+  size_t offset = stream_buffer_unmap(
+      &line_stream, num_vertices * sizeof(batch_line_vertex_t));
 
   glUseProgram(shader_2d_line_batch);
   glBindVertexArray(vao_line_batch);
-  glDrawArrays(GL_LINES, 0, num_vertices);
+  glDrawArrays(GL_LINES, offset / sizeof(batch_line_vertex_t), num_vertices);
   glBindVertexArray(0);
+  line_vertex_count = 0;
+}
+
+void render_aabb_line_batch(void) {
+  PROFILE_SCOPE("line batch");
+  flush_line_batch();
 }
 
 void render_quad(vec2 pos, vec2 size, vec4 color) {
@@ -202,30 +481,44 @@ void render_quad_lines(vec2 pos, vec2 size, vec4 color) {
   vec2 bottom_right = {pos[0] + size[0] * 0.5f, pos[1] + size[1] * 0.5f};
   vec2 bottom_left = {pos[0] - size[0] * 0.5f, pos[1] + size[1] * 0.5f};
 
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {top_left[0], top_left[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {top_right[0], top_right[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {top_right[0], top_right[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {bottom_right[0], bottom_right[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {bottom_right[0], bottom_right[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {bottom_left[0], bottom_left[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {bottom_left[0], bottom_left[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
-  *dynlist_append(line_batch_list) =
-      (batch_line_vertex_t){.position = {top_left[0], top_left[1]},
-                            .color = {color[0], color[1], color[2], color[3]}};
+  // the four lines go in together, so a full batch is drawn first
+  if (line_vertex_count + 8 > MAX_BATCH_LINE_VERTICES) {
+    PROFILE_SCOPE("line batch");
+    flush_line_batch();
+  }
+  if (line_stream.data == NULL) {
+    stream_buffer_map(&line_stream, MAX_BATCH_LINE_VERTICES *
+                                        sizeof(batch_line_vertex_t));
+  }
+  frame_stats.line_count += 4;
+
+  batch_line_vertex_t* lines =
+      (batch_line_vertex_t*)line_stream.data + line_vertex_count;
+  line_vertex_count += 8;
+  lines[0] = (batch_line_vertex_t){
+      .position = {top_left[0], top_left[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[1] = (batch_line_vertex_t){
+      .position = {top_right[0], top_right[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[2] = (batch_line_vertex_t){
+      .position = {top_right[0], top_right[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[3] = (batch_line_vertex_t){
+      .position = {bottom_right[0], bottom_right[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[4] = (batch_line_vertex_t){
+      .position = {bottom_right[0], bottom_right[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[5] = (batch_line_vertex_t){
+      .position = {bottom_left[0], bottom_left[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[6] = (batch_line_vertex_t){
+      .position = {bottom_left[0], bottom_left[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
+  lines[7] = (batch_line_vertex_t){
+      .position = {top_left[0], top_left[1]},
+      .color = {color[0], color[1], color[2], color[3]}};
 }
 
 void render_aabb(f32* aabb, vec4 color) {
@@ -248,69 +541,64 @@ static void calculate_sprite_tex_coords(vec4 result, f32 row, f32 column,
   result[3] = y + h;
 }
 
+// texture is a texture id, or a texture array id with ARRAY_TEXTURE_BIT set
+// for a quad drawn from its layer
 static void append_texture_quad(vec2 position, vec2 size, vec2 tex_coords,
-                                vec4 color, u32 texture_slot_index) {
+                                vec4 color, u32 texture, u32 layer) {
   // for batch rendering of the sprite sheet textures/frames
   vec4 tex_data = {0, 0, 1, 1}; // default data
 
   if (tex_coords != NULL) {
     memcpy(tex_data, tex_coords, sizeof(vec4));
   }
-  // append the four vertices of the quad into the batch list
+  if (dynlist_size(sprite_texture_list) == MAX_BATCH_QUADS) {
+    PROFILE_SCOPE("sprite batch");
+    flush_sprite_batch();
+  }
+  if (sprite_stream.data == NULL) {
+    stream_buffer_map(&sprite_stream,
+                      MAX_BATCH_VERTICES * sizeof(batch_sprite_vertex_t));
+  }
+  ++frame_stats.quad_count;
+
+  batch_sprite_vertex_t* quad = (batch_sprite_vertex_t*)sprite_stream.data +
+                                dynlist_size(sprite_texture_list) * 4;
+  // the slot is only known once the batch is drawn
+  *dynlist_append(sprite_texture_list) = texture;
+  // write the four vertices of the quad into the mapped batch
   // top left
-  *dynlist_append(sprite_batch_list) = (batch_sprite_vertex_t){
+  quad[0] = (batch_sprite_vertex_t){
       .position = {position[0], position[1]},
       .tex_coords = {tex_data[0], tex_data[1]},
       .color = {color[0], color[1], color[2], color[3]},
-      .texture_slot_index = texture_slot_index,
+      .texture_slot_index = layer,
   };
 
   // top right
-  *dynlist_append(sprite_batch_list) = (batch_sprite_vertex_t){
+  quad[1] = (batch_sprite_vertex_t){
       .position = {position[0] + size[0], position[1]},
       .tex_coords = {tex_data[2], tex_data[1]},
       .color = {color[0], color[1], color[2], color[3]},
-      .texture_slot_index = texture_slot_index,
+      .texture_slot_index = layer,
   };
 
   // bottom right
-  *dynlist_append(sprite_batch_list) = (batch_sprite_vertex_t){
+  quad[2] = (batch_sprite_vertex_t){
       .position = {position[0] + size[0], position[1] + size[1]},
       .tex_coords = {tex_data[2], tex_data[3]},
       .color = {color[0], color[1], color[2], color[3]},
-      .texture_slot_index = texture_slot_index,
+      .texture_slot_index = layer,
   };
 
   // bottom left
-  *dynlist_append(sprite_batch_list) = (batch_sprite_vertex_t){
+  quad[3] = (batch_sprite_vertex_t){
       .position = {position[0], position[1] + size[1]},
       .tex_coords = {tex_data[0], tex_data[3]},
       .color = {color[0], color[1], color[2], color[3]},
-      .texture_slot_index = texture_slot_index,
+      .texture_slot_index = layer,
   };
 }
 
-// returns the index of the texture slot associated to texture_id (-1 if full)
-static i32 set_texture_slot(u32 texture_id) {
-  i32 free_index = -1;
-  // the zero'th index is reserved for the default color texture
-  for (i32 i = 1; i < 8; ++i) {
-    if (texture_slots[i] == texture_id) {
-      return i;
-    }
-    if (texture_slots[i] == 0) {
-      free_index = i;
-    }
-  }
-
-  if (free_index != -1) {
-    texture_slots[free_index] = texture_id;
-  }
-
-  // returns -1 on failure
-  return free_index;
-}
-
 void render_sprite_sheet_frame(sprite_sheet_t* sprite_sheet, f32 row,
                                f32 column, vec2 position, vec2 size, vec4 color,
                                bool is_flipped) {
@@ -318,6 +606,12 @@ void render_sprite_sheet_frame(sprite_sheet_t* sprite_sheet, f32 row,
   calculate_sprite_tex_coords(tex_coords, row, column, sprite_sheet->width,
                               sprite_sheet->height, sprite_sheet->cell_width,
                               sprite_sheet->cell_height);
+  // from the sheet into the texture it is in, a no-op outside of an atlas
+  f32* uv_rect = sprite_sheet->uv_rect;
+  tex_coords[0] = uv_rect[0] + tex_coords[0] * uv_rect[2];
+  tex_coords[1] = uv_rect[1] + tex_coords[1] * uv_rect[3];
+  tex_coords[2] = uv_rect[0] + tex_coords[2] * uv_rect[2];
+  tex_coords[3] = uv_rect[1] + tex_coords[3] * uv_rect[3];
   if (is_flipped) {
     // flip the x-axis
     f32 tmp = tex_coords[0];
@@ -331,9 +625,12 @@ void render_sprite_sheet_frame(sprite_sheet_t* sprite_sheet, f32 row,
   vec2 bottom_left =
       (vec2){position[0] - size[0] * 0.5, position[1] - size[1] * 0.5};
 
-  i32 texture_slot = set_texture_slot(sprite_sheet->texture_id);
-  ASSERT(texture_slot != -1, "need to implement flushing the texture slots");
-  append_texture_quad(bottom_left, size, tex_coords, color, texture_slot);
+  u32 texture = sprite_sheet->texture_id;
+  if (sprite_sheet->is_array_layer) {
+    texture |= ARRAY_TEXTURE_BIT;
+  }
+  append_texture_quad(bottom_left, size, tex_coords, color, texture,
+                      sprite_sheet->layer);
 }
 
 void render_begin_3d(camera_t* camera) {
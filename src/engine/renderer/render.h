@@ -17,14 +17,19 @@ typedef struct {
 
 typedef struct {
   f32 width, height, cell_width, cell_height;
-  u32 texture_id;
+  u32 texture_id; // the texture array when is_array_layer
+  u32 layer;
+  bool is_array_layer; // see render_init_sprite_sheet_layer
+  // x, y, width, height of the sheet in its texture as texture coordinates,
+  // 0, 0, 1, 1 unless it was packed in an atlas
+  vec4 uv_rect;
 } sprite_sheet_t;
 
 typedef struct {
   vec2 position;
   vec2 tex_coords;
   vec4 color;
-  u32 texture_slot_index;
+  u32 texture_slot_index; // the layer for texture array sprites
 } batch_sprite_vertex_t;
 
 typedef struct {
@@ -32,10 +37,26 @@ typedef struct {
   vec4 color;
 } batch_line_vertex_t;
 
+// the size of one draw, a batch that fills up is drawn and started over, so a
+// frame can submit any number of quads and lines
 #define MAX_BATCH_QUADS 10000
 #define MAX_BATCH_LINES MAX_BATCH_QUADS
 #define MAX_BATCH_VERTICES 4 * MAX_BATCH_QUADS // four common vertices per quad, for ebo
 #define MAX_BATCH_ELEMENTS 6 * MAX_BATCH_QUADS // one for each corner of the two triangles
+#define MAX_BATCH_LINE_VERTICES 2 * MAX_BATCH_LINES
+// full batches the streamed batch buffers hold before they are orphaned
+#define STREAM_BUFFER_BATCHES 3
+// upper bound on the textures one sprite draw can sample, the count used is
+// also limited by GL_MAX_TEXTURE_IMAGE_UNITS. slot zero is the white texture.
+#define MAX_TEXTURE_SLOTS 32
+
+// counts for the last complete frame, from render_begin to render_end
+typedef struct {
+  u32 quad_count;
+  u32 line_count;
+  u32 sprite_flushes; // draw calls the sprite batch took
+  u32 line_flushes;   // draw calls the line batch took
+} render_stats_t;
 
 void render_init(u32 width, u32 height, f32 scale, vec4 bg_color);
 void render_destroy(void);
@@ -47,11 +68,20 @@ void render_end(void);
 
 f32 render_get_render_scale(void);
 fv2 render_get_render_size(void);
+render_stats_t render_get_stats(void);
+// whether a sprite batch that takes more than one draw, from using more
+// textures than there are slots or mixing texture arrays with other sheets,
+// is drawn ordered by texture in the fewest draws rather than in submission
+// order. off by default: with no depth test the later sprite is drawn on top,
+// so sorting only suits scenes whose overlapping sprites share a texture.
+bool* render_get_sort_by_texture(void);
+u32 render_get_texture_slot_count(void);
 
 // ---- 2d rendering pass ----
 // sets up the orthographic projection, disables depth testing.
 void render_begin_2d(void);
-// flushes all batched sprites/lines to the screen
+// flushes all batched sprites/lines to the screen. batches also flush on
+// their own once full, drawing what was submitted before in order.
 void render_sprite_batch(void);
 void render_aabb_line_batch(void);
 void render_quad(vec2 pos, vec2 size, vec4 color);
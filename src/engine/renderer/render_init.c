@@ -1,5 +1,6 @@
 #include "render_init.h"
 
+#include "../c-lib/math.h"
 #include "../c-lib/misc.h"
 #include "../io/io.h"
 #include "../math/math.h"
@@ -10,6 +11,7 @@
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <stdio.h>
+#include <string.h>
 
 static void framebuffer_size_callback(GLFWwindow* window, int width,
                                       int height) {
@@ -67,12 +69,26 @@ void render_init_color_texture(u32* texture) {
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-static u32 compile_shader(const char* shader_src, u32 shader_type) {
+u32 render_init_texture_slots(void) {
+  int unit_count;
+  glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &unit_count);
+  printf("Texture image units: %d\n", unit_count);
+  return min((u32)unit_count, (u32)MAX_TEXTURE_SLOTS);
+}
+
+// defines go in right after the #version line, which has to come first
+static u32 compile_shader(const char* shader_src, u32 shader_type,
+                          const char* defines) {
   int success;
   char log[512];
 
+  const char* version_end = strchr(shader_src, '\n');
+  ASSERT(version_end, "shader is missing its #version line\n");
+  const char* sources[3] = {shader_src, defines, version_end + 1};
+  int lengths[3] = {(int)(version_end + 1 - shader_src), -1, -1};
+
   u32 shader = glCreateShader(shader_type);
-  glShaderSource(shader, 1, &shader_src, NULL);
+  glShaderSource(shader, 3, sources, lengths);
   glCompileShader(shader);
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
@@ -82,14 +98,17 @@ static u32 compile_shader(const char* shader_src, u32 shader_type) {
   return shader;
 }
 
-static u32 create_shader_program(const char* path_vert, const char* path_frag) {
+static u32 create_shader_program(const char* path_vert, const char* path_frag,
+                                 const char* defines) {
   file_t file_vert = io_file_read(path_vert);
   ASSERT(file_vert.is_valid, "error reading vertex shader file\n");
   file_t file_frag = io_file_read(path_frag);
   ASSERT(file_frag.is_valid, "error reading fragment shader file\n");
 
-  u32 shader_vertex = compile_shader(file_vert.data, GL_VERTEX_SHADER);
-  u32 shader_fragment = compile_shader(file_frag.data, GL_FRAGMENT_SHADER);
+  u32 shader_vertex =
+      compile_shader(file_vert.data, GL_VERTEX_SHADER, defines);
+  u32 shader_fragment =
+      compile_shader(file_frag.data, GL_FRAGMENT_SHADER, defines);
 
   int success;
   char log[512];
@@ -114,12 +133,22 @@ static u32 create_shader_program(const char* path_vert, const char* path_frag) {
 }
 
 void render_init_shaders(u32* out_shader_2d, u32* out_shader_2d_sprite_batch,
+                         u32* out_shader_2d_sprite_array_batch,
                          u32* out_shader_2d_line_batch, u32* out_shader_3d,
-                         f32 render_width, f32 render_height) {
+                         f32 render_width, f32 render_height,
+                         u32 texture_slot_count) {
+  // the sampler array in texture_batch.frag is sized by TEXTURE_SLOT_COUNT
+  char defines[64];
+  snprintf(defines, sizeof(defines), "#define TEXTURE_SLOT_COUNT %u\n",
+           texture_slot_count);
 #define PREFIX "./src/engine/shaders/"
-#define PROG(fname) create_shader_program(PREFIX #fname ".vert", PREFIX #fname ".frag")
+#define PROG(fname) create_shader_program(PREFIX #fname ".vert", PREFIX #fname ".frag", defines)
   *out_shader_2d = PROG(default);
   *out_shader_2d_sprite_batch = PROG(texture_batch);
+  // same vertices as the sprite batch, only sampled differently
+  *out_shader_2d_sprite_array_batch =
+      create_shader_program(PREFIX "texture_batch.vert",
+                            PREFIX "texture_array_batch.frag", defines);
   *out_shader_2d_line_batch = PROG(line_batch);
   *out_shader_3d = PROG(3d);
 #undef PROG
@@ -145,10 +174,13 @@ void render_init_shaders(u32* out_shader_2d, u32* out_shader_2d_sprite_batch,
       GL_TRUE, &projection_2d.data[0]);
   // the texture slot represents what texture is used for the active texture
   // (ie, GL_TEXTURE0, GL_TEXTURE1, etc).
-  int slots[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+  int slots[MAX_TEXTURE_SLOTS];
+  for (u32 i = 0; i < texture_slot_count; ++i) {
+    slots[i] = i;
+  }
   glUniform1iv(
-      glGetUniformLocation(*out_shader_2d_sprite_batch, "texture_slots"), 8,
-      slots);
+      glGetUniformLocation(*out_shader_2d_sprite_batch, "texture_slots"),
+      texture_slot_count, slots);
   /*
   Each batch vertex will have a texture slot index. The slot index maps to the
   texture id in the engine. When we go to render the batch, we then link the
@@ -156,6 +188,16 @@ void render_init_shaders(u32* out_shader_2d, u32* out_shader_2d_sprite_batch,
   corresponding texture ids that we have per slot in the engine.
   */
 
+  // the texture array variant reads the slot index as the layer of the one
+  // array bound to GL_TEXTURE0
+  glUseProgram(*out_shader_2d_sprite_array_batch);
+  glUniformMatrix4fv(
+      glGetUniformLocation(*out_shader_2d_sprite_array_batch, "projection"), 1,
+      GL_TRUE, &projection_2d.data[0]);
+  glUniform1i(
+      glGetUniformLocation(*out_shader_2d_sprite_array_batch, "texture_array"),
+      0);
+
   // the projection and view matrices for the 3D shader are set per-frame in
   // render_begin_3d by the client, we only need to set the texture uniform
   glUseProgram(*out_shader_3d);
@@ -228,7 +270,8 @@ void render_init_line(u32* vao, u32* vbo) {
   glBindBuffer(GL_ARRAY_BUFFER, 0); // unbind the vbo
 }
 
-void render_init_batch_texture_quads(u32* vao, u32* vbo, u32* ebo) {
+void render_init_batch_texture_quads(u32* vao, u32* vbo, u32* ebo,
+                                     u32* sorted_ebo) {
   glGenVertexArrays(1, vao);
   glBindVertexArray(*vao);
 
@@ -252,10 +295,11 @@ void render_init_batch_texture_quads(u32* vao, u32* vbo, u32* ebo) {
   glGenBuffers(1, vbo);
   glBindBuffer(GL_ARRAY_BUFFER, *vbo);
   glBufferData(GL_ARRAY_BUFFER,
-               MAX_BATCH_VERTICES * sizeof(batch_sprite_vertex_t), NULL,
-               GL_DYNAMIC_DRAW);
-  // vbo data is NULL, as we will be updating the contents at each frame,
-  // thus we want touse GL_DYNAMIC_DRAW, just like with the line segments
+               STREAM_BUFFER_BATCHES * MAX_BATCH_VERTICES *
+                   sizeof(batch_sprite_vertex_t),
+               NULL, GL_STREAM_DRAW);
+  // vbo data is NULL, the batches are written into it through mapped ranges
+  // every frame, see stream_buffer_map
 
   // [x, y], [u, v], [r, g, b, a], [texture_slot]
   glEnableVertexAttribArray(0);
@@ -282,6 +326,16 @@ void render_init_batch_texture_quads(u32* vao, u32* vbo, u32* ebo) {
   glBindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  // the indices of batches drawn ordered by texture, written per draw and
+  // only bound in place of the ebo for those. bound to the copy target so the
+  // vao is left alone.
+  glGenBuffers(1, sorted_ebo);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, *sorted_ebo);
+  glBufferData(GL_COPY_WRITE_BUFFER,
+               STREAM_BUFFER_BATCHES * MAX_BATCH_ELEMENTS * sizeof(u32), NULL,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
 void render_init_batch_lines(u32* vao, u32* vbo) {
@@ -290,8 +344,10 @@ void render_init_batch_lines(u32* vao, u32* vbo) {
 
   glGenBuffers(1, vbo);
   glBindBuffer(GL_ARRAY_BUFFER, *vbo);
-  glBufferData(GL_ARRAY_BUFFER, MAX_BATCH_LINES * sizeof(batch_line_vertex_t),
-               NULL, GL_DYNAMIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER,
+               STREAM_BUFFER_BATCHES * MAX_BATCH_LINE_VERTICES *
+                   sizeof(batch_line_vertex_t),
+               NULL, GL_STREAM_DRAW);
 
   // [x, y], [r, g, b, a]
   glEnableVertexAttribArray(0);
@@ -331,6 +387,68 @@ void render_init_sprite_sheet(sprite_sheet_t* sprite_sheet, const char* path,
   sprite_sheet->height = (f32)height;
   sprite_sheet->cell_width = cell_width;
   sprite_sheet->cell_height = cell_height;
+  sprite_sheet->layer = 0;
+  sprite_sheet->is_array_layer = false;
+  memcpy(sprite_sheet->uv_rect, (vec4){0, 0, 1, 1}, sizeof(vec4));
+}
+
+void render_init_texture_array(u32* texture_array, u32 width, u32 height,
+                               u32 layer_count) {
+  glGenTextures(1, texture_array);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, *texture_array);
+
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // nearest for pixel art, same as the single sprite sheets
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // storage only, the layers are filled in as the sheets are loaded
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layer_count, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void render_init_sprite_sheet_layer(sprite_sheet_t* sprite_sheet,
+                                    u32 texture_array, u32 layer,
+                                    const char* path, f32 cell_width,
+                                    f32 cell_height) {
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+
+  int array_width, array_height, layer_count;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH,
+                           &array_width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_HEIGHT,
+                           &array_height);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_DEPTH,
+                           &layer_count);
+  ASSERT(layer < (u32)layer_count, "layer %u is past the %d of the array",
+         layer, layer_count);
+
+  int width, height, channel_count;
+  // force loading the image with 4 channels (RGBA)
+  u8* image_data = stbi_load(path, &width, &height, &channel_count, 4);
+  ASSERT(image_data, "failed to load image from stb image: %s", path);
+  // the texture coordinates of a sheet are relative to its own size, so it
+  // has to fill the whole layer
+  ASSERT(width == array_width && height == array_height,
+         "%s is %dx%d, the texture array %dx%d", path, width, height,
+         array_width, array_height);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1,
+                  GL_RGBA, GL_UNSIGNED_BYTE, image_data);
+  stbi_image_free(image_data);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  sprite_sheet->width = (f32)width;
+  sprite_sheet->height = (f32)height;
+  sprite_sheet->cell_width = cell_width;
+  sprite_sheet->cell_height = cell_height;
+  sprite_sheet->texture_id = texture_array;
+  sprite_sheet->layer = layer;
+  sprite_sheet->is_array_layer = true;
+  memcpy(sprite_sheet->uv_rect, (vec4){0, 0, 1, 1}, sizeof(vec4));
 }
 
 void render_init_cube(u32* vao, u32* vbo, u32* ebo) {
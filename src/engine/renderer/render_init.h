@@ -7,17 +7,35 @@ void render_init_window(u32 width, u32 height);
 
 // initialize a 1x1 white texture for untextured draws
 void render_init_color_texture(u32* texture);
+// the texture slots the sprite batch gets, GL_MAX_TEXTURE_IMAGE_UNITS capped
+// at MAX_TEXTURE_SLOTS
+u32 render_init_texture_slots(void);
 void render_init_shaders(u32* out_shader_2d, u32* out_shader_2d_sprite_batch,
+                         u32* out_shader_2d_sprite_array_batch,
                          u32* out_shader_2d_line_batch, u32* out_shader_3d,
-                         f32 render_width, f32 render_height);
+                         f32 render_width, f32 render_height,
+                         u32 texture_slot_count);
 
 // ---- 2d geometry initializers ----
 void render_init_quad(u32* vao, u32* vbo, u32* ebo);
 void render_init_line(u32* vao, u32* vbo);
-void render_init_batch_texture_quads(u32* vao, u32* vbo, u32* ebo);
+// sorted_ebo takes the indices of batches drawn ordered by texture
+void render_init_batch_texture_quads(u32* vao, u32* vbo, u32* ebo,
+                                     u32* sorted_ebo);
 void render_init_batch_lines(u32* vao, u32* vbo);
 void render_init_sprite_sheet(sprite_sheet_t* sprite_sheet, const char* path,
                               f32 cell_width, f32 cell_height);
+// texture arrays hold sprite sheets of one size as layers of a single
+// texture. sprites of every sheet in an array are drawn together in one call
+// with no texture slots involved, so sheets that are drawn interleaved should
+// share one. layer_count is fixed once created.
+void render_init_texture_array(u32* texture_array, u32 width, u32 height,
+                               u32 layer_count);
+// loads the image at path into the layer, it has to be as large as the array
+void render_init_sprite_sheet_layer(sprite_sheet_t* sprite_sheet,
+                                    u32 texture_array, u32 layer,
+                                    const char* path, f32 cell_width,
+                                    f32 cell_height);
 
 // ---- 3d geometry initializers ----
 void render_init_cube(u32* vao, u32* vbo, u32* ebo);
@@ -0,0 +1,15 @@
+#version 330 core
+out vec4 frag_color;
+
+in vec4 color;
+in vec2 tex_coords;
+flat in int texture_slot_index; // the layer, see texture_batch.vert
+
+uniform sampler2DArray texture_array; // set to be 0 once
+
+void main() {
+  // a layer index is an ordinary coordinate, so unlike the texture slots it
+  // can differ between the fragments of one draw
+  frag_color =
+      texture(texture_array, vec3(tex_coords, texture_slot_index)) * color;
+}
@@ -5,7 +5,8 @@ in vec4 color;
 in vec2 tex_coords;
 flat in int texture_slot_index;
 
-uniform sampler2D texture_slots[8]; // set to be 0,1,2,3,4,5,6,7 once
+// set to be 0, 1, 2, ... once, TEXTURE_SLOT_COUNT is defined by the engine
+uniform sampler2D texture_slots[TEXTURE_SLOT_COUNT];
 
 void main() {
   // might have to change this because of: https://stackoverflow.com/a/74729081
@@ -5,6 +5,8 @@
 #include <GLFW/glfw3.h>
 
 #include "../c-lib/log.h"
+#include "../c-lib/math.h"
+#include "../profile/profile.h"
 #include "../state.h"
 #include "time.h"
 
@@ -12,14 +14,44 @@ void time_init(f32 frame_rate) {
   state.time.frame_rate = frame_rate;
   state.time.frame_delay = 1000.f / frame_rate;    // ms per frame
   state.time.last = (f32)(glfwGetTime() * 1000.0); // convert to ms
+  time_set_tick_rate(0, 1);
   LOG("Time system initialized");
 }
 
+void time_set_tick_rate(f32 tick_rate, u32 max_substeps) {
+  state.time.tick_rate = tick_rate;
+  state.time.tick_delta = tick_rate > 0.0f ? 1.0f / tick_rate : 0.0f;
+  state.time.max_substeps = max_substeps > 0 ? max_substeps : 1;
+  state.time.accumulator = 0.0f;
+  state.time.alpha = 1.0f;
+  state.time.tick_count = 0;
+}
+
+static void time_update_ticks(void) {
+  if (state.time.tick_rate <= 0.0f) {
+    // variable step, a single tick covering the whole frame
+    state.time.tick_delta = state.time.delta;
+    state.time.tick_count = 1;
+    state.time.alpha = 1.0f;
+    return;
+  }
+
+  f32 max_time = state.time.max_substeps * state.time.tick_delta;
+  state.time.accumulator = min(state.time.accumulator + state.time.delta,
+                               max_time);
+
+  state.time.tick_count =
+      (u32)(state.time.accumulator / state.time.tick_delta);
+  state.time.accumulator -= state.time.tick_count * state.time.tick_delta;
+  state.time.alpha = state.time.accumulator / state.time.tick_delta;
+}
+
 void time_update(void) {
   state.time.now = (f32)(glfwGetTime() * 1000.0);                  // ms
   state.time.delta = (state.time.now - state.time.last) / 1000.0f; // s
   state.time.last = state.time.now;
   ++state.time.frame_count;
+  time_update_ticks();
 
   if (state.time.now - state.time.frame_last >= 1000.0f) {
     state.time.frame_rate = state.time.frame_count;
@@ -29,6 +61,7 @@ void time_update(void) {
 }
 
 void time_update_late(void) {
+  PROFILE_SCOPE("frame wait");
   state.time.frame_time = (f32)(glfwGetTime() * 1000.0) - state.time.now;
 
   if (state.time.frame_delay > state.time.frame_time) {
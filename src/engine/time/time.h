@@ -8,8 +8,18 @@ typedef struct {
   f32 frame_last, frame_delay, frame_time;
 
   u32 frame_rate, frame_count;
+
+  // fixed step, see time_set_tick_rate. tick_count ticks of tick_delta
+  // seconds should be simulated this frame, alpha is how far the leftover
+  // time is into the next tick (for interpolating what is rendered)
+  f32 tick_rate, tick_delta, accumulator, alpha;
+  u32 max_substeps, tick_count;
 } time_state_t;
 
 void time_init(f32 frame_rate);
+// ticks per second for the fixed step, 0 steps once per frame with the frame
+// delta. at most max_substeps ticks run per frame, time beyond that is dropped
+// so that a slow frame can not make the next one slower.
+void time_set_tick_rate(f32 tick_rate, u32 max_substeps);
 void time_update(void);
 void time_update_late(void);